@@ -0,0 +1,51 @@
+# encoding: utf-8
+
+# Copyright (c) 2012 Novell, Inc.
+#
+# All Rights Reserved.
+#
+# This program is free software; you can redistribute it and/or modify it
+# under the terms of version 2 of the GNU General Public License as published
+# by the Free Software Foundation.
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+# more details.
+#
+# You should have received a copy of the GNU General Public License along
+# with this program; if not, contact Novell, Inc.
+#
+# To contact Novell about this file by physical or electronic mail, you may
+# find current contact information at www.novell.com.
+
+# Replays callbacks recorded with YAST2_STORAGE_RECORD_CALLBACKS=<file>
+# through the StorageClients callbacks without touching any disk.
+#
+# /usr/lib/YaST2/bin/y2base ./replay.rb qt <file> [speedup]
+#
+# speedup 1 keeps the original timing, n replays n times faster and 0
+# replays without any delay.
+module Yast
+  class ReplayClient < Client
+    def main
+      Yast.import "StorageClients"
+      Yast.import "StorageCallbacks"
+
+      file = WFM.Args(0)
+      speedup = (WFM.Args(1) || 1).to_i
+
+      # never record the replayed callbacks, the recording could even be
+      # the file being replayed
+      ENV.delete("YAST2_STORAGE_RECORD_CALLBACKS")
+      StorageClients.InstallCallbacks(nil)
+
+      ret = StorageCallbacks.Replay(file, speedup)
+      Builtins.y2milestone("Replay ret = %1", ret)
+
+      ret
+    end
+  end
+end
+
+Yast::ReplayClient.new.main
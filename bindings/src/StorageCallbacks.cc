@@ -44,6 +44,11 @@
 #define y2log_component "libstorage"
 
 #include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <sys/time.h>
+#include <unistd.h>
 
 #include <ycp/y2log.h>
 #include <ycp/YExpression.h>
@@ -237,8 +242,117 @@ static Y2Function* yesno_popup = NULL;
 static Y2Function* commit_error_popup = NULL;
 static Y2Function* password_popup = NULL;
 
+
+/*
+ * Recording of callback invocations. Each invocation is written as one
+ * line with tab separated fields: start offset and duration (both in
+ * microseconds), callback name, arguments and, for callbacks asking the
+ * user, the answer. Passwords are never written.
+ *
+ * Recordings are appended to the file. Every process appending to an
+ * existing recording starts with a session line since offsets are relative
+ * to the start of the recording process.
+ */
+
+static const char* recording_header = "# StorageCallbacks recording 1";
+static const char* recording_session = "# session";
+
+static ofstream* recording = NULL;
+static string recording_file;
+static long long recording_start = 0;
+
+
+static long long
+now_usec()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (long long)(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+
+static string
+num_to_string(long long num)
+{
+    ostringstream tmp;
+    tmp << num;
+    return tmp.str();
+}
+
+
+static string
+escape_field(const string& s)
+{
+    string ret;
+
+    for (string::const_iterator it = s.begin(); it != s.end(); ++it)
+    {
+	switch (*it)
+	{
+	    case '\\': ret += "\\\\"; break;
+	    case '\t': ret += "\\t"; break;
+	    case '\n': ret += "\\n"; break;
+	    default: ret += *it; break;
+	}
+    }
+
+    return ret;
+}
+
+
+static vector<string>
+split_fields(const string& line)
+{
+    vector<string> ret;
+    string field;
+
+    for (string::const_iterator it = line.begin(); it != line.end(); ++it)
+    {
+	if (*it == '\t')
+	{
+	    ret.push_back(field);
+	    field.clear();
+	}
+	else if (*it == '\\' && it + 1 != line.end())
+	{
+	    ++it;
+	    switch (*it)
+	    {
+		case 't': field += '\t'; break;
+		case 'n': field += '\n'; break;
+		default: field += *it; break;
+	    }
+	}
+	else
+	{
+	    field += *it;
+	}
+    }
+
+    ret.push_back(field);
+
+    return ret;
+}
+
+
+static void
+record(long long start, const string& callback, const vector<string>& args)
+{
+    *recording << (start - recording_start) << '\t' << (now_usec() - start) << '\t'
+	       << callback;
+
+    for (vector<string>::const_iterator it = args.begin(); it != args.end(); ++it)
+	*recording << '\t' << escape_field(*it);
+
+    *recording << '\n';
+    recording->flush();
+}
+
+
 void progress_bar_callback( const string& id, unsigned cur, unsigned max )
 {
+    long long start = now_usec();
+
     if (progress_bar)
     {
 	progress_bar->reset ();
@@ -248,10 +362,21 @@ void progress_bar_callback( const string& id, unsigned cur, unsigned max )
 	progress_bar->finishParameters ();
 	progress_bar->evaluateCall ();
     }
+
+    if (recording)
+    {
+	vector<string> args;
+	args.push_back(id);
+	args.push_back(num_to_string(cur));
+	args.push_back(num_to_string(max));
+	record(start, "ProgressBar", args);
+    }
 }
 
 void show_install_info_callback( const string& id )
 {
+    long long start = now_usec();
+
     if (show_install_info)
     {
 	show_install_info->reset ();
@@ -259,10 +384,19 @@ void show_install_info_callback( const string& id )
 	show_install_info->finishParameters ();
 	show_install_info->evaluateCall ();
     }
+
+    if (recording)
+    {
+	vector<string> args;
+	args.push_back(id);
+	record(start, "ShowInstallInfo", args);
+    }
 }
 
 void info_popup_callback( const string& text )
 {
+    long long start = now_usec();
+
     if (info_popup)
     {
 	info_popup->reset ();
@@ -270,10 +404,18 @@ void info_popup_callback( const string& text )
 	info_popup->finishParameters ();
 	info_popup->evaluateCall ();
     }
+
+    if (recording)
+    {
+	vector<string> args;
+	args.push_back(text);
+	record(start, "InfoPopup", args);
+    }
 }
 
 bool yesno_popup_callback( const string& text )
 {
+    long long start = now_usec();
     bool ret = false;
 
     if (yesno_popup)
@@ -287,12 +429,21 @@ bool yesno_popup_callback( const string& text )
             ret = tmp->asBoolean()->value();
     }
 
+    if (recording)
+    {
+	vector<string> args;
+	args.push_back(text);
+	args.push_back(ret ? "1" : "0");
+	record(start, "YesNoPopup", args);
+    }
+
     return ret;
 }
 
 
 bool commit_error_popup_callback(int error, const string& last_action, const string& extended_message)
 {
+    long long start = now_usec();
     bool ret = false;
 
     if (commit_error_popup)
@@ -308,12 +459,23 @@ bool commit_error_popup_callback(int error, const string& last_action, const str
             ret = tmp->asBoolean()->value();
     }
 
+    if (recording)
+    {
+	vector<string> args;
+	args.push_back(num_to_string(error));
+	args.push_back(last_action);
+	args.push_back(extended_message);
+	args.push_back(ret ? "1" : "0");
+	record(start, "CommitErrorPopup", args);
+    }
+
     return ret;
 }
 
 
 bool password_popup_callback(const string& device, int attempts, string& password)
 {
+    long long start = now_usec();
     bool ret = false;
 
     if (password_popup)
@@ -331,6 +493,15 @@ bool password_popup_callback(const string& device, int attempts, string& passwor
 	password = tmp2->value(1)->asString()->value();	
     }
 
+    if (recording)
+    {
+	vector<string> args;
+	args.push_back(device);
+	args.push_back(num_to_string(attempts));
+	args.push_back(ret ? "1" : "0");
+	record(start, "PasswordPopup", args);
+    }
+
     return ret;
 }
 
@@ -613,6 +784,189 @@ StorageCallbacks::PasswordPopup (const YCPString & callback)
     return YCPVoid ();
 }
 
+
+YCPValue
+StorageCallbacks::StartRecording(const YCPString& filename)
+{
+    // callbacks are installed again with every libstorage initialisation
+    if (recording && recording_file == filename->value())
+	return YCPBoolean(true);
+
+    StopRecording();
+
+    ofstream* tmp = new ofstream(filename->value().c_str(), ios::out | ios::app);
+    if (!tmp->good())
+    {
+	y2error("Cannot open %s for recording callbacks", filename->value().c_str());
+	delete tmp;
+	return YCPBoolean(false);
+    }
+
+    y2milestone("Recording callbacks to %s", filename->value().c_str());
+
+    tmp->seekp(0, ios::end);
+    if (tmp->tellp() == 0)
+	*tmp << recording_header << '\n';
+    else
+	*tmp << recording_session << '\n';
+    tmp->flush();
+
+    recording = tmp;
+    recording_file = filename->value();
+    recording_start = now_usec();
+
+    return YCPBoolean(true);
+}
+
+
+YCPValue
+StorageCallbacks::StopRecording()
+{
+    if (recording)
+    {
+	y2milestone("Stop recording callbacks");
+
+	recording->close();
+	delete recording;
+	recording = NULL;
+	recording_file.clear();
+    }
+
+    return YCPVoid();
+}
+
+
+/*
+ * Feeds a recording back through the registered callbacks. With speedup 1
+ * the original timing is kept, with n it is n times faster and with 0 the
+ * callbacks are called without any delay. Returns false if the recording
+ * cannot be read or an answer differs from the recorded one. Recording is
+ * suspended while replaying.
+ */
+YCPValue
+StorageCallbacks::Replay(const YCPString& filename, const YCPInteger& speedup)
+{
+    if (recording && recording_file == filename->value())
+    {
+	y2error("Cannot replay %s while recording to it", filename->value().c_str());
+	return YCPBoolean(false);
+    }
+
+    ifstream in(filename->value().c_str());
+    if (!in.good())
+    {
+	y2error("Cannot open %s for replaying callbacks", filename->value().c_str());
+	return YCPBoolean(false);
+    }
+
+    string line;
+    if (!getline(in, line) || line != recording_header)
+    {
+	y2error("%s is not a callback recording", filename->value().c_str());
+	return YCPBoolean(false);
+    }
+
+    y2milestone("Replaying callbacks from %s speedup:%lld", filename->value().c_str(),
+		speedup->value());
+
+    // offsets are relative to the start of their session
+    long long total_start = now_usec();
+    long long replay_start = total_start;
+    long long recorded_usec = 0;
+    long long replayed_usec = 0;
+    unsigned int calls = 0;
+    unsigned int mismatches = 0;
+    bool ok = true;
+
+    ofstream* suspended = recording;
+    recording = NULL;
+
+    while (getline(in, line))
+    {
+	if (line == recording_session)
+	{
+	    replay_start = now_usec();
+	    continue;
+	}
+
+	vector<string> fields = split_fields(line);
+	if (fields.size() < 3)
+	{
+	    y2error("Malformed recording line '%s'", line.c_str());
+	    ok = false;
+	    continue;
+	}
+
+	long long offset = atoll(fields[0].c_str());
+	const string& callback = fields[2];
+
+	if (speedup->value() > 0)
+	{
+	    long long delay = replay_start + offset / speedup->value() - now_usec();
+	    if (delay > 0)
+		usleep(delay);
+	}
+
+	long long start = now_usec();
+	bool answer = false;
+	bool has_answer = false;
+
+	if (callback == "ProgressBar" && fields.size() == 6)
+	{
+	    progress_bar_callback(fields[3], atoi(fields[4].c_str()), atoi(fields[5].c_str()));
+	}
+	else if (callback == "ShowInstallInfo" && fields.size() == 4)
+	{
+	    show_install_info_callback(fields[3]);
+	}
+	else if (callback == "InfoPopup" && fields.size() == 4)
+	{
+	    info_popup_callback(fields[3]);
+	}
+	else if (callback == "YesNoPopup" && fields.size() == 5)
+	{
+	    answer = yesno_popup_callback(fields[3]);
+	    has_answer = true;
+	}
+	else if (callback == "CommitErrorPopup" && fields.size() == 7)
+	{
+	    answer = commit_error_popup_callback(atoi(fields[3].c_str()), fields[4], fields[5]);
+	    has_answer = true;
+	}
+	else if (callback == "PasswordPopup" && fields.size() == 6)
+	{
+	    string password;
+	    answer = password_popup_callback(fields[3], atoi(fields[4].c_str()), password);
+	    has_answer = true;
+	}
+	else
+	{
+	    y2error("Unknown callback in recording line '%s'", line.c_str());
+	    ok = false;
+	    continue;
+	}
+
+	replayed_usec += now_usec() - start;
+	recorded_usec += atoll(fields[1].c_str());
+	calls++;
+
+	if (has_answer && answer != (fields.back() == "1"))
+	{
+	    y2warning("Answer of %s at %lld differs from recording", callback.c_str(), offset);
+	    mismatches++;
+	}
+    }
+
+    y2milestone("Replayed %u callbacks in %lld ms, callbacks took %lld ms (recorded %lld ms), "
+		"%u answers differ", calls, (now_usec() - total_start) / 1000,
+		replayed_usec / 1000, recorded_usec / 1000, mismatches);
+
+    recording = suspended;
+
+    return YCPBoolean(ok && mismatches == 0);
+}
+
+
 void
 log_do( int level, const string& component, const char* file, int line, const char* func,
         const string& text)
@@ -63,6 +63,14 @@ public:
     /* TYPEINFO: void(string) */
     YCPValue PasswordPopup (const YCPString& func);
 
+    // recording and replay of callback invocations
+    /* TYPEINFO: boolean(string) */
+    YCPValue StartRecording (const YCPString& filename);
+    /* TYPEINFO: void() */
+    YCPValue StopRecording ();
+    /* TYPEINFO: boolean(string,integer) */
+    YCPValue Replay (const YCPString& filename, const YCPInteger& speedup);
+
     /**
      * Constructor.
      */
@@ -136,15 +136,15 @@ module Yast
             end
 
             # search for shadowed subvolumes of root filesystem
+            mount_points = []
             targetMap.each do |dev, disk|
               parts = disk.fetch("partitions", [])
               parts.each do |other_part|
-                if other_part.has_key?("mount")
-                  shadowed = ShadowedVolList.new(partition: part, mount_point: other_part["mount"])
-                  shadowed_root_subvols += shadowed.to_a
-                end
+                mount_points << other_part["mount"] if other_part.has_key?("mount")
               end
             end
+            shadowed = ShadowedVolList.new(partition: part, mount_points: mount_points)
+            shadowed_root_subvols += shadowed.to_a
 
           elsif mountpoint == Partitions.BootMount
             if (Partitions.EfiBoot || Arch.ia64) &&
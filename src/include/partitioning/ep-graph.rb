@@ -28,6 +28,50 @@ module Yast
   module PartitioningEpGraphInclude
     def initialize_partitioning_ep_graph(include_target)
       textdomain "storage"
+
+      # graph files by graph type with the target map generation they were
+      # generated for
+      @graph_files = {}
+    end
+
+
+    # Returns a graph file for the current target map
+    #
+    # The file is only generated again if the target map changed since the
+    # last call for the same type of graph.
+    #
+    # @param [Symbol] type :device or :mount
+    # @return [String] filename
+    def GraphFile(type)
+      generation = Storage.GetTargetGeneration
+      cached = @graph_files[type]
+      if cached && cached[:generation] == generation
+        return cached[:filename]
+      end
+
+      SCR.Execute(path(".target.remove"), cached[:filename]) if cached
+
+      filename = "#{Directory.tmpdir}/#{type}-#{generation}.gv"
+      if type == :device
+        Storage.SaveDeviceGraph(filename)
+      else
+        Storage.SaveMountGraph(filename)
+      end
+
+      @graph_files[type] = { :generation => generation, :filename => filename }
+      filename
+    end
+
+
+    # Shows the current graph in the graph widget unless it already shows it
+    def RefreshGraph(type)
+      filename = GraphFile(type)
+      return if @graph_files[type][:shown] == filename
+
+      UI.ChangeWidget(Id(:graph), :Filename, filename)
+      @graph_files[type][:shown] = filename
+
+      nil
     end
 
     def EpContextMenuDeviceGraph
@@ -58,8 +102,7 @@ module Yast
 
 
     def CreateDeviceGraphPanel(user_data)
-      filename = "#{Directory.tmpdir}/device.gv"
-      Storage.SaveDeviceGraph(filename)
+      filename = GraphFile(:device)
 
       UI.ReplaceWidget(
         :tree_panel,
@@ -77,8 +120,7 @@ module Yast
           )
         )
       )
-
-      SCR.Execute(path(".target.remove"), filename)
+      @graph_files[:device][:shown] = filename
 
       # helptext
       helptext = _("<p>This view shows a graph of devices.</p>")
@@ -90,12 +132,7 @@ module Yast
 
 
     def RefreshDeviceGraphPanel(user_data)
-      filename = "#{Directory.tmpdir}/device.gv"
-      Storage.SaveDeviceGraph(filename)
-
-      UI.ChangeWidget(Id(:graph), :Filename, filename)
-
-      SCR.Execute(path(".target.remove"), filename)
+      RefreshGraph(:device)
 
       nil
     end
@@ -147,8 +184,7 @@ module Yast
 
 
     def CreateMountGraphPanel(user_data)
-      filename = "#{Directory.tmpdir}/mount.gv"
-      Storage.SaveMountGraph(filename)
+      filename = GraphFile(:mount)
 
       UI.ReplaceWidget(
         :tree_panel,
@@ -166,8 +202,7 @@ module Yast
           )
         )
       )
-
-      SCR.Execute(path(".target.remove"), filename)
+      @graph_files[:mount][:shown] = filename
 
       # helptext
       helptext = _("<p>This view shows a graph of mount points.</p>")
@@ -179,12 +214,7 @@ module Yast
 
 
     def RefreshMountGraphPanel(user_data)
-      filename = "#{Directory.tmpdir}/mount.gv"
-      Storage.SaveMountGraph(filename)
-
-      UI.ChangeWidget(Id(:graph), :Filename, filename)
-
-      SCR.Execute(path(".target.remove"), filename)
+      RefreshGraph(:mount)
 
       nil
     end
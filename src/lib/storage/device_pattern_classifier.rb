@@ -0,0 +1,95 @@
+# encoding: utf-8
+
+# Copyright (c) 2016 Novell, Inc.
+#
+# All Rights Reserved.
+#
+# This program is free software; you can redistribute it and/or modify it
+# under the terms of version 2 of the GNU General Public License as published
+# by the Free Software Foundation.
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+# more details.
+#
+# You should have received a copy of the GNU General Public License along
+# with this program; if not, contact SUSE.
+#
+# To contact SUSE about this file by physical or electronic mail, you may
+# find current contact information at www.suse.com.
+
+require "yast"
+
+module Yast
+  # Assigns classes to device names using an ordered list of regular
+  # expressions
+  #
+  # The patterns are compiled once, into a single alternation if possible.
+  # The regexp engine still tries the alternatives one after the other, the
+  # combined expression only saves a Ruby call per pattern. The first
+  # pattern in the list matching wins, just as when testing them one by one.
+  class DevicePatternClassifier
+    include Yast::Logger
+
+    GROUP_PREFIX = "yast_class_"
+
+    # @param patterns [Array<Array(String, String)>] pairs of regular
+    #   expression and class name
+    def initialize(patterns)
+      @classes = []
+      @regexps = []
+      patterns.each do |pattern, klass|
+        begin
+          @regexps << Regexp.new(pattern)
+          @classes << klass
+        rescue RegexpError => e
+          log.warn "Ignoring invalid pattern #{pattern}: #{e.message}"
+        end
+      end
+      @combined = combine(@regexps)
+    end
+
+    # Class of the first pattern matching any of the names
+    #
+    # @param names [Array<String>] alternative names of one device
+    # @return [String, nil] nil if no pattern matches
+    def match(names)
+      best = nil
+      names.each do |name|
+        idx = pattern_index(name)
+        next if idx.nil? || (best && best <= idx)
+        best = idx
+        break if best == 0
+      end
+      best && @classes[best]
+    end
+
+  protected
+
+    # Every pattern becomes a named group behind a lazy prefix anchored to
+    # the start of the string. The alternation is tried in pattern order, so
+    # the group that captures identifies the first pattern matching anywhere.
+    def combine(regexps)
+      return nil if regexps.empty?
+      @names = regexps.each_index.map { |i| "#{GROUP_PREFIX}#{i}" }
+      alternatives = regexps.each_with_index.map do |r, i|
+        "(?m:.*?)(?<#{@names[i]}>#{r.source})"
+      end
+      Regexp.new("\\A(?:#{alternatives.join("|")})")
+    rescue RegexpError => e
+      # e.g. numbered back references cannot be mixed with named groups
+      log.info "Cannot combine patterns, matching one by one: #{e.message}"
+      nil
+    end
+
+    def pattern_index(name)
+      if @combined
+        md = @combined.match(name)
+        md && @names.index { |n| !md[n].nil? }
+      else
+        @regexps.index { |r| r.match(name) }
+      end
+    end
+  end
+end
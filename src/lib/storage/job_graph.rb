@@ -0,0 +1,133 @@
+# encoding: utf-8
+
+# Copyright (c) 2016 SUSE LLC
+#
+# All Rights Reserved.
+#
+# This program is free software; you can redistribute it and/or modify it
+# under the terms of version 2 of the GNU General Public License as published
+# by the Free Software Foundation.
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+# more details.
+#
+# You should have received a copy of the GNU General Public License along
+# with this program; if not, contact SUSE LLC.
+#
+# To contact SUSE LLC about this file by physical or electronic mail, you may
+# find current contact information at www.suse.com.
+
+require "yast"
+
+module Yast
+  # Small graph of initialisation jobs with dependencies between them
+  #
+  # Jobs are run in levels: each level holds the jobs whose dependencies
+  # are all done. Jobs running shell commands are started concurrently in
+  # the background by a single SCR call per level, the commands of one job
+  # run one after the other. Jobs running a block are run afterwards one
+  # after the other since SCR cannot be used from several threads. The run
+  # time of every job and the exit status of every command is recorded.
+  class JobGraph
+    include Yast::Logger
+
+    Job = Struct.new(:name, :after, :commands, :block)
+
+    # prefix of the output lines reporting the exit status of a command
+    STATUS_MARK = "@yast-job-status"
+
+    # @return [Hash{Symbol => Float}] run time in seconds of the jobs done
+    attr_reader :timings
+
+    # @return [Hash{Symbol => Array<Fixnum>}] exit status of every command
+    #   of the command jobs done, -1 if it is unknown
+    attr_reader :statuses
+
+    def initialize
+      @jobs = []
+      @timings = {}
+      @statuses = {}
+    end
+
+    # Adds a job running the given block
+    #
+    # @param name [Symbol]
+    # @param after [Array<Symbol>] jobs that must be done before
+    def add(name, after: [], &block)
+      @jobs << Job.new(name, after, nil, block)
+      self
+    end
+
+    # Adds a job running shell commands one after the other, their output is
+    # discarded
+    #
+    # @param name [Symbol]
+    # @param commands [Array<String>]
+    # @param after [Array<Symbol>] jobs that must be done before
+    def command(name, commands, after: [])
+      @jobs << Job.new(name, after, commands, nil)
+      self
+    end
+
+    # Runs all jobs
+    #
+    # @raise [RuntimeError] if the dependencies cannot be satisfied
+    def run
+      pending = @jobs.dup
+      done = []
+
+      until pending.empty?
+        ready = pending.select { |job| (job.after - done).empty? }
+        if ready.empty?
+          raise "Unsatisfiable job dependencies: #{pending.map(&:name)}"
+        end
+
+        commands, others = ready.partition(&:commands)
+        run_commands(commands) if !commands.empty?
+        others.each { |job| timed([job]) { job.block.call } }
+
+        done.concat(ready.map(&:name))
+        pending -= ready
+      end
+
+      log.info "Job timings: #{@timings} statuses: #{@statuses}"
+      nil
+    end
+
+  protected
+
+    def run_commands(jobs)
+      script = jobs.each_with_index.map do |job, j|
+        steps = job.commands.each_with_index.map do |cmd, c|
+          "#{cmd} >/dev/null 2>&1; echo \"#{STATUS_MARK} #{j} #{c} $?\""
+        end
+        "( #{steps.join("; ")} ) &"
+      end
+      script = "#{script.join(" ")} wait"
+
+      out = timed(jobs) do
+        log.info "Running #{script}"
+        SCR.Execute(Yast::Path.new(".target.bash_output"), script)
+      end
+
+      jobs.each { |job| @statuses[job.name] = Array.new(job.commands.size, -1) }
+      (out || {}).fetch("stdout", "").each_line do |line|
+        mark, j, c, status = line.split
+        job = jobs[j.to_i] if mark == STATUS_MARK
+        next if job.nil? || c.to_i >= job.commands.size
+        @statuses[job.name][c.to_i] = status.to_i
+      end
+    end
+
+    # Jobs run together share the measured time
+    def timed(jobs)
+      start = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+      yield
+    ensure
+      elapsed = Process.clock_gettime(Process::CLOCK_MONOTONIC) - start
+      jobs.each { |job| @timings[job.name] = elapsed }
+    end
+  end
+end
@@ -0,0 +1,68 @@
+# Copyright (c) 2016 Novell, Inc.
+#
+# All Rights Reserved.
+#
+# This program is free software; you can redistribute it and/or modify it
+# under the terms of version 2 of the GNU General Public License as published
+# by the Free Software Foundation.
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+# more details.
+#
+# You should have received a copy of the GNU General Public License along
+# with this program; if not, contact SUSE.
+#
+# To contact SUSE about this file by physical or electronic mail, you may
+# find current contact information at www.suse.com.
+
+module Yast
+  # Set of mount points stored as a trie of path components
+  #
+  # Looking up the mount point shadowing a path only depends on the depth of
+  # the path, not on the number of mount points. A path is shadowed by a
+  # mount point if it is equal to it or lies below it.
+  class MountPointTrie
+    # @param mount_points [Array<String>]
+    def initialize(mount_points = [])
+      @root = {}
+      mount_points.each { |mount_point| add(mount_point) }
+    end
+
+    # @param mount_point [String]
+    def add(mount_point)
+      node = components(mount_point).reduce(@root) { |n, c| n[c] ||= {} }
+      node[:mount_point] ||= mount_point
+      self
+    end
+
+    # Mount point shadowing the given path
+    #
+    # @param path [String]
+    # @return [String, nil] nil if the path is not shadowed
+    def shadowing(path)
+      node = @root
+      return node[:mount_point] if node.key?(:mount_point)
+      components(path).each do |component|
+        node = node[component]
+        return nil if node.nil?
+        return node[:mount_point] if node.key?(:mount_point)
+      end
+      nil
+    end
+
+    # @param path [String]
+    def shadowed?(path)
+      !shadowing(path).nil?
+    end
+
+  protected
+
+    # Keeps empty components so "/home" does not shadow "/home2" and "/"
+    # only shadows itself and paths starting with "//"
+    def components(path)
+      path.split("/", -1)
+    end
+  end
+end
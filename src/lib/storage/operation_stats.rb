@@ -0,0 +1,162 @@
+# encoding: utf-8
+
+# Copyright (c) 2016 SUSE LLC
+#
+# All Rights Reserved.
+#
+# This program is free software; you can redistribute it and/or modify it
+# under the terms of version 2 of the GNU General Public License as published
+# by the Free Software Foundation.
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+# more details.
+#
+# You should have received a copy of the GNU General Public License along
+# with this program; if not, contact SUSE LLC.
+#
+# To contact SUSE LLC about this file by physical or electronic mail, you may
+# find current contact information at www.suse.com.
+
+require "yast"
+require "objspace"
+require "singleton"
+
+module Yast
+  # Singleton class accounting wall time, allocated objects and retained
+  # memory of the operations of the storage modules
+  #
+  # Accounting is off unless YAST2_STORAGE_STATS is set. Its value is the
+  # number of seconds between summaries written to the log (60 if it is no
+  # number). Nested operations are included in the numbers of the calling
+  # operation.
+  class OperationStats
+    include Yast::Logger
+    include Singleton
+
+    ENV_NAME = "YAST2_STORAGE_STATS"
+    DEFAULT_INTERVAL = 60
+    # number of operations listed in the log summary
+    SUMMARY_SIZE = 15
+
+    def initialize
+      env = ENV[ENV_NAME]
+      @enabled = !env.nil?
+      @interval = env.to_i > 0 ? env.to_i : DEFAULT_INTERVAL
+      @operations = {}
+      @retained = {}
+      @depth = 0
+      @last_summary = Time.now
+    end
+
+    def enabled?
+      @enabled
+    end
+
+    # Wraps methods of an object so their calls are accounted, does nothing
+    # if accounting is off
+    #
+    # @param object [Object] e.g. a YaST module
+    # @param prefix [String] prefix of the operation names
+    # @param methods [Array<Symbol>] methods to account
+    # @param sized [Array<Symbol>] methods after which the retained memory is
+    #   measured, measuring walks all registered objects so should only be
+    #   done for operations changing them
+    def instrument(object, prefix, methods, sized = [])
+      return unless enabled?
+      stats = self
+      wrapper = Module.new do
+        methods.each do |method|
+          name = "#{prefix}.#{method}"
+          measure_retained = sized.include?(method)
+          define_method(method) do |*args, &block|
+            stats.measure(name, measure_retained) { super(*args, &block) }
+          end
+        end
+      end
+      object.singleton_class.prepend(wrapper)
+      log.info "Accounting #{methods.size} operations of #{prefix}"
+      nil
+    end
+
+    # Registers an object whose retained memory is reported
+    #
+    # @param name [String]
+    # @param block [Proc] returns the object
+    def add_retained(name, &block)
+      @retained[name] = block
+    end
+
+    # Accounts the block as operation name
+    #
+    # @return result of the block
+    def measure(name, measure_retained = false)
+      start = Time.now
+      allocated = GC.stat(:total_allocated_objects)
+      @depth += 1
+      yield
+    ensure
+      @depth -= 1
+      time = Time.now - start
+      op = @operations[name] ||= {
+        "calls" => 0, "time" => 0.0, "max_time" => 0.0, "allocated" => 0
+      }
+      op["calls"] += 1
+      op["time"] += time
+      op["max_time"] = time if time > op["max_time"]
+      op["allocated"] += GC.stat(:total_allocated_objects) - allocated
+      if @depth == 0
+        op["retained"] = retained if measure_retained
+        log_summary if Time.now - @last_summary >= @interval
+      end
+    end
+
+    # @return [Hash{String => Fixnum}] retained bytes of the registered objects
+    def retained
+      Hash[@retained.map { |name, block| [name, self.class.deep_size(block.call)] }]
+    end
+
+    # @return [Hash] accounted operations and current retained memory
+    def stats
+      {
+        "enabled"    => enabled?,
+        "operations" => Marshal.load(Marshal.dump(@operations)),
+        "retained"   => enabled? ? retained : {}
+      }
+    end
+
+    # Writes the most allocating operations and the retained memory to the log
+    def log_summary
+      @last_summary = Time.now
+      top = @operations.sort_by { |_name, op| -op["allocated"] }.first(SUMMARY_SIZE)
+      log.info "Operation stats (by allocated objects):"
+      top.each do |name, op|
+        log.info format(
+          "  %-40s calls:%d time:%.3fs max:%.3fs allocated:%d retained:%s",
+          name, op["calls"], op["time"], op["max_time"], op["allocated"],
+          op.fetch("retained", "-")
+        )
+      end
+      log.info "Retained memory: #{retained}"
+      log.info "GC: #{GC.stat.select { |k, _v| [:count, :heap_live_slots, :total_allocated_objects].include?(k) }}"
+    end
+
+    # Memory of an object and all hashes, arrays and strings reachable from
+    # it, shared objects are only counted once
+    #
+    # @return [Fixnum] bytes
+    def self.deep_size(obj, seen = {}.compare_by_identity)
+      return 0 if seen.key?(obj)
+      seen[obj] = true
+      size = ObjectSpace.memsize_of(obj)
+      case obj
+      when Hash
+        obj.each { |k, v| size += deep_size(k, seen) + deep_size(v, seen) }
+      when Array
+        obj.each { |v| size += deep_size(v, seen) }
+      end
+      size
+    end
+  end
+end
@@ -50,10 +50,11 @@ module Yast
     #
     # @param target_map [Hash] map with the partitions layout
     def root_partition(target_map: Storage.GetTargetMap)
-      return unless doable?(target_map)
-      root_copy = deep_dup(root_part(target_map))
+      parts = partitions(target_map)
+      return unless doable?(parts)
+      root_copy = shallow_copy(root_part(parts))
       restore_aborted_subvols(root_copy)
-      abort_shadowed_subvols(root_copy, target_map)
+      abort_shadowed_subvols(root_copy, parts)
       log.info "New list of subvolumes: #{root_copy["subvol"]}"
       root_copy
     end
@@ -66,8 +67,14 @@ module Yast
 
   protected
 
-    def deep_dup(hash)
-      Marshal.load(Marshal.dump(hash))
+    # Copy of the partition sharing everything but the list of subvolumes
+    #
+    # Subvolumes are never modified in place but replaced in the copied list,
+    # so the original partition is not affected.
+    def shallow_copy(partition)
+      copy = partition.dup
+      copy["subvol"] = copy["subvol"].dup if copy.has_key?("subvol")
+      copy
     end
 
     def partitions(target_map)
@@ -76,16 +83,16 @@ module Yast
       end
     end
 
-    def root_part(target_map)
-      partitions(target_map).detect {|p| p["mount"] == "/" }
+    def root_part(parts)
+      parts.detect {|p| p["mount"] == "/" }
     end
 
     def is_root?(partition)
       partition["mount"] == "/"
     end
 
-    def doable?(target_map)
-      if root_part(target_map).nil?
+    def doable?(parts)
+      if root_part(parts).nil?
         log.info "No root partition found, skipping shadowed volumes update"
         false
       else
@@ -97,50 +104,60 @@ module Yast
       @aborted_subvols ||= []
     end
 
-    def abort_shadowed_subvols(target_part, target_map)
-      partitions(target_map).each do |part|
-        if !is_root?(part) && part.has_key?("mount")
-          abort_shadowed_subvols_for(target_part, part["mount"])
-        end
-      end
-    end
-
     # Aborts creation of shadowed subvolumes
-    def abort_shadowed_subvols_for(target_part, mount_point)
-      shadowed = ShadowedVolList.new(partition: target_part, mount_point: mount_point)
-      shadowed.each do |subvol|
-        log.debug "Subvol to abort: #{subvol}"
-        # Only abort planned volumes (don't delete pre-existing ones)
-        if !subvol["create"]
-          log.info "Skipping subvolume #{subvol["name"]}"
-          next
-        end
+    def abort_shadowed_subvols(target_part, parts)
+      mount_points = parts.each_with_object([]) do |part, list|
+        list << part["mount"] if !is_root?(part) && part.has_key?("mount")
+      end
+      shadowed = ShadowedVolList.new(partition: target_part, mount_points: mount_points)
+      shadowed = shadowed.each_with_object({}.compare_by_identity) { |s, h| h[s] = true }
+      return if shadowed.empty?
 
-        log.info "Deleting subvolume #{subvol["name"]}"
-        # Store it, so we can restore it
-        memorize(subvol)
-        # Mark it for removal ("delete" takes precedence over "create")
-        subvol["delete"] = true
+      target_part["subvol"].map! do |subvol|
+        shadowed.key?(subvol) ? abort_subvol(subvol) : subvol
       end
       log.debug "Aborted subvols: #{aborted_subvols}"
     end
 
+    # Subvolume to use instead of a shadowed one
+    def abort_subvol(subvol)
+      log.debug "Subvol to abort: #{subvol}"
+      # Only abort planned volumes (don't delete pre-existing ones)
+      if !subvol["create"]
+        log.info "Skipping subvolume #{subvol["name"]}"
+        return subvol
+      end
+
+      log.info "Deleting subvolume #{subvol["name"]}"
+      # Store it, so we can restore it
+      memorize(subvol)
+      # Mark it for removal ("delete" takes precedence over "create")
+      subvol.merge("delete" => true)
+    end
+
     def memorize(subvol)
       aborted_subvols << subvol.dup
     end
 
     def restore_aborted_subvols(target_part)
-      aborted_subvols.each do |subvol|
-        name = subvol["name"]
-        log.info "Restore subvol #{name}?"
-        log.debug "subvol: #{subvol}"
-        existing_subvol = target_part["subvol"].detect { |s| s["name"] == name}
-        if existing_subvol.nil?
-          log.info "Restoring subvol"
-          target_part["subvol"] << subvol
-        elsif existing_subvol["delete"]
-          log.info "Rejecting subvol deletion"
-          existing_subvol["delete"] = false
+      if !aborted_subvols.empty?
+        subvols = target_part["subvol"] ||= []
+        index = {}
+        subvols.each_with_index { |s, i| index[s["name"]] ||= i }
+
+        aborted_subvols.each do |subvol|
+          name = subvol["name"]
+          log.info "Restore subvol #{name}?"
+          log.debug "subvol: #{subvol}"
+          i = index[name]
+          if i.nil?
+            log.info "Restoring subvol"
+            index[name] = subvols.size
+            subvols << subvol
+          elsif subvols[i]["delete"]
+            log.info "Rejecting subvol deletion"
+            subvols[i] = subvols[i].merge("delete" => false)
+          end
         end
       end
       reset
@@ -18,19 +18,27 @@
 # find current contact information at www.suse.com.
 
 require "yast"
+require "storage/mount_point_trie"
 Yast.import "FileSystems"
 
 module Yast
+  # Subvolumes of a partition shadowed by one or several mount points
   class ShadowedVolList
     include Enumerable
     include Yast::Logger
 
-    attr_reader :partition, :mount_point
+    attr_reader :partition, :mount_points
 
-    def initialize(partition: nil, mount_point: nil)
-      raise ArgumentError unless partition && mount_point
+    # @param partition [Hash] partition with the subvolumes
+    # @param mount_point [String] shadowing mount point
+    # @param mount_points [Array<String>] several shadowing mount points,
+    #   alternative to mount_point
+    def initialize(partition: nil, mount_point: nil, mount_points: nil)
+      mount_points ||= [mount_point] if mount_point
+      raise ArgumentError unless partition && mount_points
       @partition = partition
-      @mount_point = mount_point
+      @mount_points = mount_points
+      @trie = MountPointTrie.new(mount_points)
       @volumes = selected_volumes
     end
 
@@ -50,7 +58,7 @@ module Yast
     end
 
     def shadowed?(name)
-      (name == mount_point) || name.start_with?("#{mount_point}/")
+      @trie.shadowed?(name)
     end
 
     def full_name(subvol)
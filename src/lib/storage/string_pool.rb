@@ -0,0 +1,74 @@
+# encoding: utf-8
+
+# Copyright (c) 2016 SUSE LLC
+#
+# All Rights Reserved.
+#
+# This program is free software; you can redistribute it and/or modify it
+# under the terms of version 2 of the GNU General Public License as published
+# by the Free Software Foundation.
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+# more details.
+#
+# You should have received a copy of the GNU General Public License along
+# with this program; if not, contact SUSE LLC.
+#
+# To contact SUSE LLC about this file by physical or electronic mail, you may
+# find current contact information at www.suse.com.
+
+module Yast
+  # Table of frozen strings
+  #
+  # Interning a string returns the one frozen instance in the table equal to
+  # it, so strings repeated in many maps, like device names, are only stored
+  # once. Yast.deep_copy does not copy strings, so copies of the maps share
+  # them as well. Comparing two interned strings only compares their
+  # identity since String#== checks that first.
+  #
+  # Interned strings end up in maps returned by the published API, so callers
+  # modifying them in place (<<, sub!, force_encoding) get a FrozenError and
+  # have to dup them first.
+  class StringPool
+    def initialize
+      @strings = {}
+    end
+
+    # @param str [String, nil]
+    # @return [String, nil] frozen string equal to str
+    def intern(str)
+      return nil if str.nil?
+      @strings.fetch(str) do
+        str = str.dup.freeze
+        @strings[str] = str
+      end
+    end
+
+    # @param strs [Enumerable<String>]
+    # @return [Array<String>] frozen strings equal to strs
+    def intern_all(strs)
+      strs.map { |str| intern(str) }
+    end
+
+    # Interned string equal to str without adding it to the table
+    #
+    # @param str [String]
+    # @return [String] str itself if it is not interned
+    def find(str)
+      @strings.fetch(str, str)
+    end
+
+    # @return [Fixnum] number of interned strings
+    def size
+      @strings.size
+    end
+
+    # Forgets all interned strings, strings handed out before stay frozen
+    def clear
+      @strings.clear
+      nil
+    end
+  end
+end
@@ -0,0 +1,202 @@
+# encoding: utf-8
+
+# Copyright (c) 2016 Novell, Inc.
+#
+# All Rights Reserved.
+#
+# This program is free software; you can redistribute it and/or modify it
+# under the terms of version 2 of the GNU General Public License as published
+# by the Free Software Foundation.
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+# more details.
+#
+# You should have received a copy of the GNU General Public License along
+# with this program; if not, contact SUSE.
+#
+# To contact SUSE about this file by physical or electronic mail, you may
+# find current contact information at www.suse.com.
+
+require "yast"
+
+module Yast
+  # Stream of changes of the target map
+  #
+  # Every new generation of the target map is recorded as an event
+  # describing which devices were added, removed or changed and which keys of
+  # the changed devices differ:
+  #
+  #   $[ "generation" : 42,
+  #      "added" : [ "/dev/sda3" ],
+  #      "removed" : [ "/dev/system/home" ],
+  #      "changed" : $[ "/dev/sda" : [ "free_cyl" ] ] ]
+  #
+  # Devices are containers and their not deleted partitions (volumes), keyed
+  # by device name. Partitions sharing their device name within a container
+  # (e.g. several tmpfs mounts) are keyed "<device>@<mount point>", or
+  # "<device>@<position>" if that is ambiguous too. Instead of copies of the
+  # devices only hashes of their values are kept per container, so nothing is
+  # computed until the first consumer asks for changes and a new generation
+  # only hashes the containers it touched.
+  class TargetMapChanges
+    include Yast::Logger
+
+    # number of events kept for #since
+    MAX_EVENTS = 100
+
+    def initialize
+      @generation = 0
+      @containers = nil
+      @events = []
+      @subscribers = {}
+      @next_id = 0
+    end
+
+    # Whether changes are being recorded
+    def tracking?
+      !@containers.nil?
+    end
+
+    # Starts recording changes with the given target map as base
+    #
+    # @param generation [Fixnum] generation of target_map
+    # @param target_map [Hash{String => map}]
+    def track(generation, target_map)
+      return if tracking?
+      log.info "Start tracking target map changes at generation #{generation}"
+      @generation = generation
+      @containers = {}
+      target_map.each { |dev, container| @containers[dev] = fingerprints(dev, container) }
+      nil
+    end
+
+    # Records a new generation of the target map and notifies the subscribers
+    #
+    # @param generation [Fixnum] new generation
+    # @param target_map [Hash{String => map}]
+    # @param containers [Array<String>, nil] keys of the containers that may
+    #   have changed (including added or removed ones), nil for all
+    # @return [Hash, nil] event, nil if changes are not tracked
+    def record(generation, target_map, containers = nil)
+      @generation = generation
+      return nil unless tracking?
+      containers ||= @containers.keys | target_map.keys
+      old_devices = {}
+      new_devices = {}
+      containers.uniq.each do |dev|
+        merge_devices(old_devices, @containers[dev])
+        if target_map.key?(dev)
+          @containers[dev] = fingerprints(dev, target_map[dev])
+          merge_devices(new_devices, @containers[dev])
+        else
+          @containers.delete(dev)
+        end
+      end
+      # shared by all subscribers and #since, so nobody may change it
+      event = { "generation" => generation }.merge(diff(old_devices, new_devices))
+      deep_freeze(event)
+      @events << event
+      @events.shift while @events.size > MAX_EVENTS
+      log.info "Target map changes #{event}"
+      @subscribers.each_value { |subscriber| subscriber.call(event) }
+      event
+    end
+
+    # Events of all generations after the given one
+    #
+    # @param generation [Fixnum]
+    # @return [Array<Hash>, nil] nil if the events are not known (anymore),
+    #   the consumer then has to reread the whole target map
+    def since(generation)
+      return nil unless tracking?
+      return [] if generation >= @generation
+      first = @events.first
+      return nil if first.nil? || first["generation"] > generation + 1
+      @events.select { |event| event["generation"] > generation }
+    end
+
+    # Calls the block with every event recorded from now on, the events are
+    # frozen
+    #
+    # @return [Fixnum] id for #unsubscribe
+    def subscribe(&block)
+      @next_id += 1
+      @subscribers[@next_id] = block
+      @next_id
+    end
+
+    # @param id [Fixnum] id returned by #subscribe
+    def unsubscribe(id)
+      !@subscribers.delete(id).nil?
+    end
+
+  protected
+
+    # Map from device key to map from key to hash of the value for a
+    # container and its partitions
+    def fingerprints(dev, container)
+      devices = { dev => fingerprint(container) }
+      partitions = (container["partitions"] || []).each_with_index.reject do |p, _i|
+        p["delete"]
+      end
+      partitions.group_by { |p, _i| p["device"] }.each do |name, group|
+        if group.size == 1
+          devices[name] = fingerprint(group[0][0]) if !devices.key?(name)
+          next
+        end
+        mounts = group.map { |p, _i| p["mount"] }
+        group.each do |p, i|
+          mount = p["mount"]
+          unique = !mount.nil? && !mount.empty? && mounts.count(mount) == 1
+          devices["#{name}@#{unique ? mount : i}"] = fingerprint(p)
+        end
+      end
+      devices
+    end
+
+    # Adds the devices of a container, devices also seen in a previous
+    # container are kept
+    def merge_devices(devices, container_devices)
+      return if container_devices.nil?
+      devices.merge!(container_devices) { |_key, old, _new| old }
+    end
+
+    def fingerprint(device)
+      ret = {}
+      device.each { |key, value| ret[key] = value.hash if key != "partitions" }
+      ret
+    end
+
+    def deep_freeze(obj)
+      case obj
+      when Hash
+        obj.each do |key, value|
+          deep_freeze(key)
+          deep_freeze(value)
+        end
+      when Array
+        obj.each { |value| deep_freeze(value) }
+      end
+      obj.freeze
+    end
+
+    def diff(old_devices, new_devices)
+      changed = {}
+      new_devices.each do |dev, values|
+        old_values = old_devices[dev]
+        next if old_values.nil? || old_values == values
+        keys = (old_values.keys | values.keys).select do |key|
+          old_values[key] != values[key]
+        end
+        changed[dev] = keys
+      end
+      {
+        "added"   => new_devices.keys - old_devices.keys,
+        "removed" => old_devices.keys - new_devices.keys,
+        "changed" => changed
+      }
+    end
+  end
+end
@@ -162,12 +162,23 @@ module Yast
           ::Storage::FC    => :FT_FC
         }
 
+      # Suffix of the names of volumes sharing their device name in target
+      # map changes, see TargetMapChanges
+      SHARED_NAME_SUFFIX = %r{@(/.*|\d+)\z}
+
       #
       #----------------------------------------------------------------------
       #
 
       def initialize(storage_interface = nil)
         @storage = storage_interface
+        # cached feature sets by container device and by volume device
+        @container_features = {}
+        @volume_features = {}
+        # volume devices of every btrfs filesystem as of the last
+        # collect_features, keyed "UUID=<uuid>" like btrfs volumes on several
+        # devices in the target map
+        @btrfs_devices = {}
       end
 
       def init_lazy
@@ -179,26 +190,103 @@ module Yast
       # Collect storage features and return a feature list
       # (a list containing :FT_xy symbols). The list may be empty.
       #
+      # The features of every container and volume are cached by device
+      # name, so calling this again only checks devices that were added or
+      # invalidated since the last call.
+      #
       # @return [Array<Symbol>] feature list
       #
       def collect_features
         init_lazy
         log.info("Collecting storage features")
         features = Set.new
+        @checked = 0
+
         containers = ::Storage::DequeContainerInfo.new
         @storage.getContainers(containers)
-        containers.each { |c| features.merge(collect_container_features(c)) }
+        containers = containers.to_a.map { |c| [c.device, c] }.to_h
+        @container_features.select! { |dev, _f| containers.key?(dev) }
+        containers.each do |dev, c|
+          features.merge(cached(@container_features, dev) { collect_container_features(c) })
+        end
 
         volumes = ::Storage::DequeVolumeInfo.new
         @storage.getVolumes(volumes)
-        volumes.each { |v| features.merge(collect_volume_features(v)) }
+        # the same device can show up as several volumes, e.g. a partition
+        # and the btrfs volume on it
+        volumes = volumes.to_a.group_by(&:device)
+        @volume_features.select! { |dev, _f| volumes.key?(dev) }
+        @btrfs_devices = btrfs_devices(volumes)
+        volumes.each do |dev, vols|
+          features.merge(cached(@volume_features, dev) do
+            vols.map { |v| collect_volume_features(v) }.reduce(Set.new, :merge)
+          end)
+        end
 
         feature_check(features, "System", "") { @storage.getEfiBoot ? :FT_EFIBOOT : nil }
+        log.info("Checked #{@checked} of #{containers.size + volumes.size} devices")
         log.info("Storage features used: #{features.to_a}")
 
         features.to_a
       end
 
+      # Forget the cached features of some devices, so the next
+      # collect_features checks them again.
+      #
+      # A btrfs volume named "UUID=<uuid>" invalidates all volumes that
+      # belonged to it at the last collect_features. Volumes sharing a device
+      # name like tmpfs mounts are named "<device>@<mount point>" or
+      # "<device>@<position>" in target map changes, they invalidate the
+      # device.
+      #
+      # @param [Array<String>] device names, nil for all devices
+      #
+      def invalidate(devices = nil)
+        if devices.nil?
+          @container_features.clear
+          @volume_features.clear
+        else
+          devices = devices.map { |dev| dev.sub(SHARED_NAME_SUFFIX, "") }
+          devices = devices.flat_map { |dev| [dev] + @btrfs_devices.fetch(dev, []) }
+          devices.each do |dev|
+            @container_features.delete(dev)
+            @volume_features.delete(dev)
+          end
+        end
+        nil
+      end
+
+      # Return the cached feature set of a device, computing it with the
+      # block if it is not cached.
+      #
+      # @param [Hash{String => Set<Symbol>}] cache
+      # @param [String] device name
+      # @return [Set<Symbol>] feature set
+      #
+      def cached(cache, device, &block)
+        cache.fetch(device) do
+          @checked += 1
+          cache[device] = block.call
+        end
+      end
+
+      # Map the btrfs filesystems to the devices of their volumes
+      #
+      # @param [Hash{String => Array<VolumeInfo>}] volumes by device
+      # @return [Hash{String => Array<String>}] devices by "UUID=<uuid>"
+      #
+      def btrfs_devices(volumes)
+        ret = {}
+        volumes.each do |dev, vols|
+          vols.each do |vol|
+            next if vol.fs != ::Storage::BTRFS || vol.uuid.empty?
+            devices = ret["UUID=#{vol.uuid}"] ||= []
+            devices << dev if !devices.include?(dev)
+          end
+        end
+        ret
+      end
+
       # Collect storage features for one container and return a feature set.
       #
       # @param [ContainerInfo] data for one container (from libstorage)
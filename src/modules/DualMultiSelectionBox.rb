@@ -26,6 +26,7 @@
 #
 # The items must have the `id() as their first element.
 require "yast"
+require "storage/device_pattern_classifier"
 
 module Yast
   class DualMultiSelectionBoxClass < Module
@@ -256,41 +257,30 @@ module Yast
       deep_copy(ret)
     end
 
+    # Assigns to every device in dc the class of the first pattern in plst
+    # matching its kernel name, udev id or udev path
     def FindDeviceMatches(dc, plst)
-      plst = deep_copy(plst)
+      classifier = DevicePatternClassifier.new(plst)
       tg = Storage.GetTargetMap
+      index = Storage.GetPartitionIndex(tg)
       dc.value = Builtins.mapmap(dc.value) do |d, c|
-        p = Storage.GetPartition(tg, d)
-        Builtins.y2milestone("FindDeviceMatches %1 is %2", d, p)
-        match = Builtins.find(plst) do |m|
-          found = Builtins.regexpmatch(d, Ops.get_string(m, 0, ""))
-          if !found
-            found = Builtins.regexpmatch(
-              Ops.get_string(p, "device", ""),
-              Ops.get_string(m, 0, "")
-            )
-          end
-          if !found
-            id = Builtins.find(Ops.get_list(p, "udev_id", [])) do |s|
-              Builtins.regexpmatch(
-                Ops.add("/dev/disk/by-id/", s),
-                Ops.get_string(m, 0, "")
-              )
-            end
-            found = id != nil
-          end
-          if !found
-            found = Builtins.regexpmatch(
-              Ops.add("/dev/disk/by-path/", Ops.get_string(p, "udev_path", "")),
-              Ops.get_string(m, 0, "")
-            )
-          end
-          found
-        end
-        Builtins.y2milestone("FindDeviceMatches match %1 is %2", d, match)
-        c = Ops.get_string(match, 1, "") if match != nil
+        p = index.fetch(d) { Storage.GetPartition(tg, d) }
+        Builtins.y2debug("FindDeviceMatches %1 is %2", d, p)
+        names = [d, Ops.get_string(p, "device", "")]
+        names.concat(
+          Ops.get_list(p, "udev_id", []).map { |s| "/dev/disk/by-id/#{s}" }
+        )
+        names << "/dev/disk/by-path/#{Ops.get_string(p, "udev_path", "")}"
+        match = classifier.match(names)
+        Builtins.y2debug("FindDeviceMatches match %1 is %2", d, match)
+        c = match if match != nil
         { d => c }
       end
+      Builtins.y2milestone(
+        "FindDeviceMatches %1 devices %2 classified",
+        Builtins.size(dc.value),
+        dc.value.count { |_d, c| !Builtins.isempty(c) }
+      )
 
       nil
     end
@@ -476,8 +466,9 @@ module Yast
             :from => "any",
             :to   => "list <term>"
           )
+          lset = Builtins.listmap(ls) { |s| { s => true } }
           itl = Builtins.maplist(itl) do |t|
-            if Builtins.contains(ls, Ops.get_string(t, 1, ""))
+            if lset.has_key?(Ops.get_string(t, 1, ""))
               Ops.set(t, 2, let)
             end
             deep_copy(t)
@@ -26,6 +26,9 @@ require "storage/target_map_formatter"
 require "storage/used_storage_features"
 require "storage/shadowed_vol_helper"
 require "storage/subvol"
+require "storage/target_map_changes"
+require "storage/operation_stats"
+require "storage/string_pool"
 
 module Yast
   class StorageClass < Module
@@ -289,6 +292,15 @@ module Yast
 
       @probe_done = false
       @exit_key = :next
+
+      # increased whenever the target map changes
+      @target_generation = 0
+      # events describing the changes of the target map
+      @target_changes = TargetMapChanges.new
+      # storage features cached between calls and the target map generation
+      # they are valid for
+      @used_features = nil
+      @used_features_generation = 0
       @sint = nil
       @conts = []
 
@@ -298,7 +310,25 @@ module Yast
 
 
       @dbus_cookie = nil
+      # names of the backup states kept by libstorage
+      @backup_states = []
+      # device names, udev ids and paths shared by all target maps
+      @names = StringPool.new
       Storage()
+
+      stats = OperationStats.instance
+      stats.add_retained("Storage.StorageMap") { @StorageMap }
+      stats.add_retained("Storage.conts") { @conts }
+      stats.instrument(
+        self,
+        "Storage",
+        self.class.published_functions.keys,
+        [
+          :UpdateTargetMap, :UpdateTargetMapDisk, :UpdateTargetMapDev,
+          :SetTargetMap, :CreateTargetBackup, :RestoreTargetBackup,
+          :DisposeTargetBackup, :CommitChanges
+        ]
+      )
     end
 
 
@@ -354,6 +384,8 @@ module Yast
 
       FileSystems.InitSlib(@sint)
       Partitions.InitSlib(@sint)
+      # a collector used before got its own storage interface
+      @used_features = nil
 
       true
     end
@@ -365,6 +397,10 @@ module Yast
       log.info("FinishLibstorage")
       ::Storage::destroyStorageInterface(@sint)
       @sint = nil
+      @used_features = nil
+      @backup_states = []
+      @names.clear
+      OperationStats.instance.log_summary if OperationStats.instance.enabled?
 
       nil
     end
@@ -797,6 +833,9 @@ module Yast
     # return list of partitions of map <tg>
     def GetPartitionLst(tg, device)
       tg = deep_copy(tg)
+      # with the interned name comparing it to device names of the target
+      # map is an identity check
+      device = @names.find(device)
       ret = []
       tmp = GetDiskPartitionTg(device, tg)
       Builtins.y2milestone("GetPartitionLst tmp: %1", tmp)
@@ -849,6 +888,11 @@ module Yast
     end
 
 
+    # Returns partition identified by 'device' taken from the 'tg' (target)
+    # map, its strings are frozen as described in GetTargetMap
+    #
+    # @param [Hash{String => map}] tg (target map)
+    # @param [String] device
     def GetPartition(tg, device)
       tg = deep_copy(tg)
       Convert.convert(
@@ -859,7 +903,8 @@ module Yast
     end
 
 
-    # Returns disk identified by 'device' taken from the 'tg' (target) map
+    # Returns disk identified by 'device' taken from the 'tg' (target) map,
+    # its strings are frozen as described in GetTargetMap
     #
     # @param [Hash{String => map}] tg (target map)
     # @param [String] device
@@ -1272,9 +1317,11 @@ module Yast
       Ops.set(d, "cyl_size", dinfo.cylSize)
       Ops.set(d, "cyl_count", dinfo.cyl)
       Ops.set(d, "sector_size", dinfo.sectorSize)
-      Ops.set(d, "label", dinfo.disklabel)
+      Ops.set(d, "label", @names.intern(dinfo.disklabel))
       tmp = dinfo.orig_disklabel
-      Ops.set(d, "orig_label", tmp) if Ops.greater_than(Builtins.size(tmp), 0)
+      if Ops.greater_than(Builtins.size(tmp), 0)
+        Ops.set(d, "orig_label", @names.intern(tmp))
+      end
       Ops.set(d, "max_logical", dinfo.maxLogical)
       Ops.set(d, "max_primary", dinfo.maxPrimary)
       Ops.set(d, "dasd_format", dinfo.dasd_format)
@@ -1310,7 +1357,7 @@ module Yast
       d = deep_copy(d)
       dinfo = infos.d
       d = diskMap(dinfo, d)
-      d["devices"] = infos.devices.to_a
+      d["devices"] = @names.intern_all(infos.devices.to_a)
       Ops.set(d, "minor", infos.minor)
       Builtins.y2milestone("dmPartCoMap ret: %1", d)
       deep_copy(d)
@@ -1320,13 +1367,13 @@ module Yast
     def deviceMap(info)
 
       ret = {
-        "device" => info.device,
-        "name" => info.name
+        "device" => @names.intern(info.device),
+        "name" => @names.intern(info.name)
       }
 
       tmp = []
       info.usedBy.each do |used_by|
-        tmp.push({ "type" => toSymbol(@conv_usedby, used_by.type), "device" => used_by.device })
+        tmp.push({ "type" => toSymbol(@conv_usedby, used_by.type), "device" => @names.intern(used_by.device) })
       end
 
       if tmp.empty?
@@ -1338,8 +1385,8 @@ module Yast
         ret["used_by_device"] = tmp[0]["device"]
       end
 
-      ret["udev_path"] = info.udevPath if !info.udevPath.empty?
-      ret["udev_id"] = info.udevId.to_a if !info.udevId.empty?
+      ret["udev_path"] = @names.intern(info.udevPath) if !info.udevPath.empty?
+      ret["udev_id"] = @names.intern_all(info.udevId.to_a) if !info.udevId.empty?
 
       if !info.userdata.empty?
         # there's no to_h for the swig stl map object
@@ -1359,7 +1406,7 @@ module Yast
       p = deep_copy(p)
       p.merge!(deviceMap(vinfo))
       tmp = vinfo.crypt_device
-      Ops.set(p, "crypt_device", tmp) if !Builtins.isempty(tmp)
+      Ops.set(p, "crypt_device", @names.intern(tmp)) if !Builtins.isempty(tmp)
       Ops.set(p, "size_k", vinfo.sizeK)
       fs = toSymbol(FileSystems.conv_fs, vinfo.fs)
       Ops.set(p, "used_fs", fs) if fs != :unknown
@@ -1607,8 +1654,8 @@ module Yast
           )
         end
 
-        c["devices"] = infos.devices.to_a
-        c["spares" ] = infos.spares.to_a if !infos.spares.empty?
+        c["devices"] = @names.intern_all(infos.devices.to_a)
+        c["spares" ] = @names.intern_all(infos.spares.to_a) if !infos.spares.empty?
 
         t2 = infos.type
         Ops.set(
@@ -1658,9 +1705,9 @@ module Yast
           Ops.set(c, "pe_free", infos.peFree)
           Ops.set(c, "lvm2", infos.lvm2)
 
-          c["devices"] = infos.devices.to_a
-          c["devices_add"] = infos.devices_add.to_a if !infos.devices_add.empty?
-          c["devices_rem"] = infos.devices_rem.to_a if !infos.devices_rem.empty?
+          c["devices"] = @names.intern_all(infos.devices.to_a)
+          c["devices_add"] = @names.intern_all(infos.devices_add.to_a) if !infos.devices_add.empty?
+          c["devices_rem"] = @names.intern_all(infos.devices_rem.to_a) if !infos.devices_rem.empty?
         else
           Builtins.y2warning(
             "LVM Vg \"%1\" ret: %2",
@@ -1724,8 +1771,8 @@ module Yast
           Ops.set(p, "sb_ver", info.sb_ver)
           Ops.set(p, "raid_inactive", true) if info.inactive
 
-          p["devices"] = info.devices.to_a
-          p["spares"] = info.spares.to_a if !info.spares.empty?
+          p["devices"] = @names.intern_all(info.devices.to_a)
+          p["spares"] = @names.intern_all(info.spares.to_a) if !info.spares.empty?
 
           Ops.set(
             c,
@@ -1798,41 +1845,10 @@ module Yast
         Builtins.y2milestone("after getBtrfsInfo")
         Builtins.y2warning("getBtrfsInfo ret: %1", ret) if ret<0
         pinfos.each do |info|
-          p = {}
-          vinfo = info.v
-          p = volumeMap(vinfo, p)
-          Ops.set(p, "type", :btrfs)
-          Ops.set(p, "fstype", Partitions.btrfs_name)
-
-          p["devices"] = info.devices.to_a
-          p["devices_add"] = info.devices_add.to_a if !info.devices_add.empty?
-          p["devices_rem"] = info.devices_rem.to_a if !info.devices_rem.empty?
-
-          if !info.subvolumes.empty?
-            p["subvol"] = info.subvolumes.map do |subvolume|
-              tmp = { "name" => subvolume.path }
-              tmp["nocow"] = subvolume.nocow if subvolume.nocow
-              tmp["create"] = subvolume.created if subvolume.created
-              tmp["delete"] = subvolume.deleted if subvolume.deleted
-              tmp
-            end
-          end
-
-	  vols = 0;
-	  vols += p["devices"].size if( p.has_key?("devices") )
-	  vols += p["devices_add"].size if( p.has_key?("devices_add") )
-          if vols>1
-             !Builtins.isempty(Ops.get_list(p, "devices_add", []))
-            Ops.set(
-              p,
-              "device",
-              Ops.add("UUID=", Ops.get_string(p, "uuid", ""))
-            )
-          end
           Ops.set(
             c,
             "partitions",
-            Builtins.add(Ops.get_list(c, "partitions", []), p)
+            Builtins.add(Ops.get_list(c, "partitions", []), btrfsVolumeMap(info))
           )
         end
       elsif Ops.get_symbol(c, "type", :CT_UNKNOWN) == :CT_TMPFS
@@ -1861,6 +1877,45 @@ module Yast
     end
 
 
+    # Returns map for btrfs volume info
+    #
+    # @param [::Storage::BtrfsInfo] info
+    # @return [Hash] btrfs volume as used in the /dev/btrfs container
+    def btrfsVolumeMap(info)
+      p = {}
+      vinfo = info.v
+      p = volumeMap(vinfo, p)
+      Ops.set(p, "type", :btrfs)
+      Ops.set(p, "fstype", Partitions.btrfs_name)
+
+      p["devices"] = @names.intern_all(info.devices.to_a)
+      p["devices_add"] = @names.intern_all(info.devices_add.to_a) if !info.devices_add.empty?
+      p["devices_rem"] = @names.intern_all(info.devices_rem.to_a) if !info.devices_rem.empty?
+
+      if !info.subvolumes.empty?
+        p["subvol"] = info.subvolumes.map do |subvolume|
+          tmp = { "name" => subvolume.path }
+          tmp["nocow"] = subvolume.nocow if subvolume.nocow
+          tmp["create"] = subvolume.created if subvolume.created
+          tmp["delete"] = subvolume.deleted if subvolume.deleted
+          tmp
+        end
+      end
+
+      vols = 0
+      vols += p["devices"].size if p.has_key?("devices")
+      vols += p["devices_add"].size if p.has_key?("devices_add")
+      if vols>1
+        Ops.set(
+          p,
+          "device",
+          Ops.add("UUID=", Ops.get_string(p, "uuid", ""))
+        )
+      end
+      p
+    end
+
+
     def toDiskMap(disk, cinfo)
       disk = deep_copy(disk)
       cinfo = deep_copy(cinfo)
@@ -1923,58 +1978,161 @@ module Yast
     end
 
 
+    # Returns map from device name to partition for all not deleted
+    # partitions in target map tg except btrfs volumes. The partitions are
+    # shared with tg, not copied. Faster than calling GetPartition for many
+    # devices of the same target map.
+    #
+    # @param [Hash{String => map}] tg
+    # @return [Hash{String => map}]
+    def GetPartitionIndex(tg)
+      index = {}
+      tg.each do |dev, disk|
+        next if dev == "/dev/btrfs"
+        (disk["partitions"] || []).each do |p|
+          next if p["delete"] || index.has_key?(p["device"])
+          index[p["device"]] = p
+        end
+      end
+      index
+    end
+
+
+    # Moves btrfs volumes with only one device from the /dev/btrfs container
+    # into the partition holding them
+    #
+    # The passed target map is not modified. Only the containers and
+    # partitions changed are copied, all other entries are shared with tg.
+    #
+    # @param [Hash{String => map}] tg
+    # @return [Hash{String => map}] changed target map
     def HandleBtrfsSimpleVolumes(tg)
-      tg = deep_copy(tg)
-      if Builtins.haskey(tg, "/dev/btrfs")
-        btrfs_partitions = Ops.get_list(tg, ["/dev/btrfs", "partitions"], [])
-        simple = Builtins.filter(btrfs_partitions) do |p|
-          p["devices"].nil? || p["devices"].size <= 1
-        end
-        tg["/dev/btrfs"]["partitions"] = Builtins.filter(btrfs_partitions) do |p|
-          p["devices"] &&  p["devices"].size > 1
-        end
-        Builtins.y2milestone("HandleBtrfsSimpleVolumes simple\n%1", format_target_map(simple))
-        keys = [
-          "subvol",
-          "uuid",
-          "label",
-          "format",
-          "inactive",
-          "mount",
-          "mountby",
-          "used_fs",
-          "fstopt",
-          "userdata"
-        ]
-        Builtins.foreach(simple) do |p|
-          mp = GetPartition(tg, p["device"])
-          Builtins.y2milestone("HandleBtrfsSimpleVolumes before %1", mp)
-          Builtins.foreach(keys) do |k|
-            if Ops.get(p, k) != nil
-              Builtins.y2milestone("HandleBtrfsSimpleVolumes set key %1", k)
-              tg = SetPartitionData(
-                tg,
-                Ops.get_string(p, "device", ""),
-                k,
-                Ops.get(p, k)
-              )
-            else
-              if Builtins.haskey(mp, k)
-                Builtins.y2milestone(
-                  "HandleBtrfsSimpleVolumes remove key %1",
-                  k
-                )
-                tg = DelPartitionData(tg, Ops.get_string(p, "device", ""), k)
-              end
-            end
+      return tg if !Builtins.haskey(tg, "/dev/btrfs")
+      tg = tg.dup
+      tg["/dev/btrfs"] = tg["/dev/btrfs"].dup
+      btrfs_partitions = Ops.get_list(tg, ["/dev/btrfs", "partitions"], [])
+      simple, multi = btrfs_partitions.partition do |p|
+        p["devices"].nil? || p["devices"].size <= 1
+      end
+      tg["/dev/btrfs"]["partitions"] = multi
+      return tg if simple.empty?
+
+      Builtins.y2milestone("HandleBtrfsSimpleVolumes simple\n%1", format_target_map(simple))
+      keys = [
+        "subvol",
+        "uuid",
+        "label",
+        "format",
+        "inactive",
+        "mount",
+        "mountby",
+        "used_fs",
+        "fstopt",
+        "userdata"
+      ]
+      index = partitionPositions(tg)
+      copied = {}
+      simple.each do |p|
+        device = Ops.get_string(p, "device", "")
+        set_keys, del_keys = keys.partition { |k| !p[k].nil? }
+        Builtins.y2milestone(
+          "HandleBtrfsSimpleVolumes %1 set keys %2 remove keys %3",
+          device,
+          set_keys,
+          del_keys
+        )
+        dev, pos = index[device]
+        if dev != nil
+          if !copied[dev]
+            tg[dev] = tg[dev].dup
+            tg[dev]["partitions"] = tg[dev]["partitions"].dup
+            copied[dev] = true
           end
-          Builtins.y2milestone(
-            "HandleBtrfsSimpleVolumes after  %1",
-            GetPartition(tg, Ops.get_string(p, "device", ""))
-          )
+          mp = tg[dev]["partitions"][pos] = tg[dev]["partitions"][pos].dup
+          set_keys.each { |k| mp[k] = deep_copy(p[k]) }
+          del_keys.each { |k| mp.delete(k) }
+        else
+          set_keys.each { |k| tg = SetPartitionData(tg, device, k, p[k]) }
+          del_keys.each { |k| tg = DelPartitionData(tg, device, k) }
         end
       end
-      deep_copy(tg)
+      tg
+    end
+
+
+    # Returns map from device name to container key and position in its
+    # partitions for the partitions listed by GetPartitionIndex
+    #
+    # @param [Hash{String => map}] tg
+    # @return [Hash{String => Array}]
+    def partitionPositions(tg)
+      index = {}
+      tg.each do |dev, disk|
+        next if dev == "/dev/btrfs"
+        (disk["partitions"] || []).each_with_index do |p, pos|
+          next if p["delete"] || index.has_key?(p["device"])
+          index[p["device"]] = [dev, pos]
+        end
+      end
+      index
+    end
+
+
+    # Refreshes the btrfs volumes in target map tg. Only volumes using one of
+    # devices are read again from libstorage, all other volumes are kept.
+    # Refreshed simple volumes are moved into their partitions.
+    #
+    # @param [Hash{String => map}] tg
+    # @param [Array<String>] devices changed devices
+    # @return [Hash{String => map}] changed target map
+    def refreshBtrfsVolumes(tg, devices)
+      if !Builtins.haskey(tg, "/dev/btrfs")
+        Ops.set(tg, "/dev/btrfs", getContainerInfo({ "type" => :CT_BTRFS }))
+        return HandleBtrfsSimpleVolumes(tg)
+      end
+
+      old = {}
+      Ops.get_list(tg, ["/dev/btrfs", "partitions"], []).each do |p|
+        old[p["uuid"]] = p if !Builtins.isempty(p["uuid"])
+      end
+
+      pinfos = ::Storage::DequeBtrfsInfo.new()
+      ret = @sint.getBtrfsInfo(pinfos)
+      Builtins.y2warning("getBtrfsInfo ret: %1", ret) if ret<0
+
+      partitions = []
+      refreshed = []
+      pinfos.each do |info|
+        used = info.devices.to_a + info.devices_add.to_a + info.devices_rem.to_a
+        if (used & devices).empty?
+          if old.has_key?(info.v.uuid)
+            partitions << old[info.v.uuid]
+            next
+          end
+          # unchanged simple volumes are already part of their partition
+          next if info.devices.size <= 1
+        end
+        p = btrfsVolumeMap(info)
+        refreshed << p["device"]
+        partitions << p
+      end
+      Builtins.y2milestone("refreshBtrfsVolumes devices:%1 refreshed:%2", devices, refreshed)
+
+      tg["/dev/btrfs"]["partitions"] = partitions
+      HandleBtrfsSimpleVolumes(tg)
+    end
+
+
+    # Keys of the containers HandleBtrfsSimpleVolumes may have changed, i.e.
+    # /dev/btrfs and all containers with btrfs partitions
+    #
+    # @param [Hash{String => map}] tg
+    # @return [Array<String>]
+    def btrfsContainers(tg)
+      tg.keys.select do |dev|
+        dev == "/dev/btrfs" ||
+          Ops.get_list(tg, [dev, "partitions"], []).any? { |p| p["used_fs"] == :btrfs }
+      end
     end
 
 
@@ -2005,35 +2163,6 @@ module Yast
         )
       end
       tg = HandleBtrfsSimpleVolumes(tg)
-      if Builtins.haskey(tg, "/dev/btrfs")
-        simple = Builtins.filter(
-          Ops.get_list(tg, ["/dev/btrfs", "partitions"], [])
-        ) do |p|
-          Ops.less_or_equal(Builtins.size(Ops.get_list(p, "devices", [])), 1)
-        end
-        Ops.set(
-          tg,
-          ["/dev/btrfs", "partitions"],
-          Builtins.filter(Ops.get_list(tg, ["/dev/btrfs", "partitions"], [])) do |p|
-            Ops.greater_than(Builtins.size(Ops.get_list(p, "devices", [])), 1)
-          end
-        )
-        Builtins.y2milestone("simple %1", simple)
-        Builtins.foreach(simple) do |p|
-          tg = SetPartitionData(
-            tg,
-            Ops.get_string(p, "device", ""),
-            "subvol",
-            Ops.get_list(p, "subvol", [])
-          )
-          tg = SetPartitionData(
-            tg,
-            Ops.get_string(p, "device", ""),
-            "userdata",
-            Ops.get_map(p, "userdata", {})
-          )
-        end
-      end
       Builtins.y2milestone("UpdateTargetMap rem_keys: %1", rem_keys)
       Builtins.foreach(rem_keys) { |dev| tg = Builtins.remove(tg, dev) }
       Builtins.foreach(@conts) do |c|
@@ -2048,6 +2177,7 @@ module Yast
         end
       end
       Ops.set(@StorageMap, @targets_key, tg)
+      IncreaseTargetGeneration()
       #SCR::Write(.target.ycp, "/tmp/upd_all_aft_"+sformat("%1",count), StorageMap[targets_key]:$[] );
       #count = count+1;
 
@@ -2075,15 +2205,17 @@ module Yast
         end
       )
       Builtins.y2milestone("UpdateTargetMapDisk btrfs: %1", numbt)
-      if Ops.greater_than(numbt, 0) && dev != "/dev/btrfs"
-        bt = Ops.get(tg, "/dev/btrfs", {})
-        Ops.set(bt, "type", :CT_BTRFS) if Builtins.size(bt) == 0
-        Ops.set(tg, "/dev/btrfs", getContainerInfo(bt))
-      end
-      if Ops.greater_than(numbt, 0) || dev == "/dev/btrfs"
+      changed = [dev]
+      if dev == "/dev/btrfs"
         tg = HandleBtrfsSimpleVolumes(tg)
+        changed.concat(btrfsContainers(tg))
+      elsif Ops.greater_than(numbt, 0)
+        devices = Ops.get_list(tg, [dev, "partitions"], []).map { |p| p["device"] }
+        tg = refreshBtrfsVolumes(tg, devices << dev)
+        changed.concat(btrfsContainers(tg))
       end
       Ops.set(@StorageMap, @targets_key, tg)
+      IncreaseTargetGeneration(changed)
       #SCR::Write(.target.ycp, "/tmp/upd_disk_aft_"+sformat("%1",count), StorageMap[targets_key]:$[] );
       #count = count+1;
 
@@ -2144,13 +2276,13 @@ module Yast
       Builtins.y2milestone("UpdateTargetMapDev mdev\n%1", format_target_map(mdev))
       btrfs = btrfs || Ops.get_symbol(mdev, "used_fs", :unknown) == :btrfs
       Builtins.y2milestone("UpdateTargetMapDev btrfs %1", btrfs)
+      changed = [cdev]
       if btrfs
-        bt = Ops.get(tg, "/dev/btrfs", {})
-        Ops.set(bt, "type", :CT_BTRFS) if Builtins.size(bt) == 0
-        Ops.set(tg, "/dev/btrfs", getContainerInfo(bt))
-        tg = HandleBtrfsSimpleVolumes(tg)
+        tg = refreshBtrfsVolumes(tg, [dev])
+        changed.concat(btrfsContainers(tg))
       end
       Ops.set(@StorageMap, @targets_key, tg)
+      IncreaseTargetGeneration(changed)
       #SCR::Write(.target.ycp, "/tmp/upd_dev_aft_"+sformat("%1",count), StorageMap[targets_key]:$[] );
       #count = count+1;
 
@@ -2240,6 +2372,8 @@ module Yast
       ret = @sint.createBackupState(who)
       if ret<0
         Builtins.y2error("CreateTargetBackup sint ret: %1", ret)
+      else
+        @backup_states |= [who]
       end
 
       nil
@@ -2251,6 +2385,8 @@ module Yast
       ret = @sint.removeBackupState(who)
       if ret<0
         Builtins.y2error("DisposeTargetBackup sint ret: %1", ret)
+      else
+        @backup_states.delete(who)
       end
 
       nil
@@ -2296,6 +2432,77 @@ module Yast
     end
 
 
+    # Increases the target map generation, to be called whenever the target
+    # map changed
+    #
+    # @param [Array<String>] containers keys of the changed containers, nil
+    #   if any container may have changed
+    def IncreaseTargetGeneration(containers = nil)
+      @target_generation += 1
+      @target_changes.record(
+        @target_generation,
+        Ops.get_map(@StorageMap, @targets_key, {}),
+        containers
+      )
+
+      nil
+    end
+
+
+    # Returns the target map generation
+    #
+    # Unlike GetTargetChangeTime the generation changes with every update of
+    # the target map, so it can be used as key for data derived from the
+    # target map.
+    #
+    # @return [Fixnum] generation
+    def GetTargetGeneration
+      @target_generation
+    end
+
+
+    # Returns the changes of the target map after the given generation
+    #
+    # Every change is a map with the keys "generation", "added" and "removed"
+    # (lists of device names) and "changed" (map from device name to list of
+    # changed keys). Partitions sharing a device name within a container,
+    # e.g. tmpfs mounts, are named "<device>@<mount point>". Tracking starts
+    # with the first call, so consumers should first remember
+    # GetTargetGeneration and read the target map.
+    #
+    # @param [Fixnum] generation last generation known to the caller
+    # @return [Array<Hash>] changes, nil if they are unknown and the whole
+    #   target map has to be read again
+    def GetTargetChanges(generation)
+      @target_changes.track(
+        @target_generation,
+        Ops.get_map(@StorageMap, @targets_key, {})
+      )
+      deep_copy(@target_changes.since(generation))
+    end
+
+
+    # Calls the block with every change of the target map, see
+    # GetTargetChanges for the format of the changes. The changes are frozen
+    # since all subscribers get the same ones.
+    #
+    # @return [Fixnum] id for UnsubscribeTargetChanges
+    def SubscribeTargetChanges(&block)
+      @target_changes.track(
+        @target_generation,
+        Ops.get_map(@StorageMap, @targets_key, {})
+      )
+      @target_changes.subscribe(&block)
+    end
+
+
+    # @param [Fixnum] id returned by SubscribeTargetChanges
+    # @return [Boolean] true if the subscription existed
+    def UnsubscribeTargetChanges(id)
+      @target_changes.unsubscribe(id)
+    end
+
+
     def GetPartProposalActive
       Ops.get_boolean(@StorageMap, @part_proposal_active_key, true)
     end
@@ -2446,7 +2653,7 @@ module Yast
                 info = info_ref.value;
                 _GetContVolInfo_result
               )
-              @part_insts = Ops.get_string(info, "vdevice", "")
+              @part_insts = @names.intern(Ops.get_string(info, "vdevice", ""))
             end
           end
         end
@@ -4413,6 +4620,10 @@ module Yast
 
     # Returns a system target map.
     #
+    # Device names, udev ids and paths, labels and the device lists of
+    # volumes in the target map are frozen strings shared by all copies of
+    # it, they have to be duplicated before modifying them in place.
+    #
     # @return [Hash{String => map}] target map
     #
     #
@@ -4541,6 +4752,7 @@ module Yast
           AddMountPointsForWin(tmp)
         end
         Ops.set(@StorageMap, @targets_key, GetTargetMap())
+        IncreaseTargetGeneration()
         SCR.Write(path(".target.ycp"), SaveDumpPath("targetMap_ii"), tmp)
         Builtins.y2milestone("changed done")
       end
@@ -4838,7 +5050,11 @@ module Yast
 
       Builtins.y2milestone("start reread need_reread: %1", need_reread)
       @probe_done = false
-      @sint.rescanEverything() if need_reread
+      if need_reread
+        @sint.rescanEverything()
+        # names of devices gone with the rescan are not kept
+        @names.clear
+      end
       @conts = getContainers
       GetTargetMap()
     end
@@ -4865,9 +5081,62 @@ module Yast
     end
 
 
+    # Returns the collector of used storage features
+    #
+    # The collector is kept between calls while libstorage is initialized.
+    # Devices changed in the target map since the last call are invalidated,
+    # so only they are checked again. For btrfs volumes on several devices
+    # the devices are invalidated too.
+    def usedStorageFeatures
+      if @used_features.nil? || @sint.nil?
+        @used_features = Yast::StorageHelpers::UsedStorageFeatures.new(@sint)
+        GetTargetChanges(@target_generation)
+      else
+        changes = GetTargetChanges(@used_features_generation)
+        if changes.nil?
+          @used_features.invalidate
+        else
+          btrfs = Ops.get_list(
+            @StorageMap,
+            [@targets_key, "/dev/btrfs", "partitions"],
+            []
+          )
+          changes.each do |change|
+            devices = change["added"] + change["removed"] + change["changed"].keys
+            btrfs.each do |p|
+              next if !devices.include?(p["device"])
+              devices.concat(p["devices"] || [])
+              devices.concat(p["devices_add"] || [])
+              devices.concat(p["devices_rem"] || [])
+            end
+            @used_features.invalidate(devices)
+          end
+        end
+      end
+      @used_features_generation = @target_generation
+      @used_features
+    end
+
+
+    # Returns time, allocated objects and retained memory of the operations
+    # of Storage and StorageProposal
+    #
+    # Accounting is only done if YAST2_STORAGE_STATS is set, see
+    # OperationStats. Backup states are kept by libstorage, so only their
+    # names are reported.
+    #
+    # @return [Hash] map with "enabled", "operations", "retained" and
+    #   "backup_states"
+    def GetStats
+      ret = OperationStats.instance.stats
+      ret["backup_states"] = deep_copy(@backup_states)
+      ret
+    end
+
+
     # return list of missing packages in the running system
     def missing_packages
-      used_features = Yast::StorageHelpers::UsedStorageFeatures.new(@sint)
+      used_features = usedStorageFeatures
       features = used_features.collect_features
       packages = used_features.feature_packages(features)
       packages = packages.delete_if { |package| Package.Installed(package) }
@@ -5980,7 +6249,7 @@ module Yast
     def AddPackageList
       packages = @hw_packages.dup # start with packages suggested by hwinfo
 
-      used_features = Yast::StorageHelpers::UsedStorageFeatures.new(@sint)
+      used_features = usedStorageFeatures
       features = used_features.collect_features
       packages += used_features.feature_packages(features)
 
@@ -7172,6 +7441,7 @@ module Yast
     publish :function => :GetDiskPartition, :type => "map (string)"
     publish :function => :UpdateChangeTime, :type => "void ()"
     publish :function => :GetPartition, :type => "map <string, any> (map <string, map>, string)"
+    publish :function => :GetPartitionIndex, :type => "map <string, map> (map <string, map>)"
     publish :function => :GetDisk, :type => "map <string, any> (map <string, map>, string)"
     publish :function => :SwappingPartitions, :type => "list <string> ()"
     publish :function => :GetFreeInfo, :type => "boolean (string, boolean, map <symbol, any> &, boolean, map <symbol, any> &, boolean)"
@@ -7190,6 +7460,9 @@ module Yast
     publish :function => :RestoreTargetBackup, :type => "void (string)"
     publish :function => :ResetOndiskTarget, :type => "void ()"
     publish :function => :GetTargetChangeTime, :type => "integer ()"
+    publish :function => :GetTargetGeneration, :type => "integer ()"
+    publish :function => :GetTargetChanges, :type => "list <map> (integer)"
+    publish :function => :GetStats, :type => "map <string, any> ()"
     publish :function => :GetPartProposalActive, :type => "boolean ()"
     publish :function => :SetPartProposalActive, :type => "void (boolean)"
     publish :function => :GetPartMode, :type => "string ()"
@@ -143,7 +143,8 @@ module Yast
       )
 
       Builtins.y2milestone("before getErrorString error:%1", error )
-      tmp = @sint.getErrorString(error).force_encoding("UTF-8")
+      # no storage interface when replaying recorded callbacks
+      tmp = @sint ? @sint.getErrorString(error).force_encoding("UTF-8") : ""
       Builtins.y2milestone("before getErrorString ret:%1", tmp )
       text = Ops.add(Ops.add(text, tmp), "\n\n") if !Builtins.isempty(tmp)
 
@@ -232,6 +233,14 @@ module Yast
       StorageCallbacks.CommitErrorPopup("StorageClients::CommitErrorPopup")
       StorageCallbacks.PasswordPopup("StorageClients::PasswordPopup")
 
+      # record callback invocations for later replay, see
+      # bindings/ruby/replay.rb, recordings are appended and installing the
+      # callbacks again keeps recording to the same file
+      recording = ENV["YAST2_STORAGE_RECORD_CALLBACKS"]
+      if recording && !recording.empty?
+        StorageCallbacks.StartRecording(recording)
+      end
+
       nil
     end
 
@@ -31,6 +31,8 @@
 #
 # $Id$
 require "yast"
+require "shellwords"
+require "storage/job_graph"
 
 module Yast
   class StorageControllersClass < Module
@@ -58,6 +60,13 @@ module Yast
       @ModToInitrd = []
 
       @controllers = [] # set by "Probe"
+
+      # run time in seconds of the probing and initialisation steps
+      @timings = {}
+
+      # raid personalities loaded and failed to load by Initialize
+      @loaded_modules = []
+      @failed_modules = []
     end
 
     # Probe storage controllers
@@ -69,11 +78,14 @@ module Yast
 
       # probe 'storage' list
 
+      start = Process.clock_gettime(Process::CLOCK_MONOTONIC)
       @controllers = Convert.convert(
         SCR.Read(path(".probe.storage")),
         :from => "any",
         :to   => "list <map>"
       )
+      @timings["probe"] = Process.clock_gettime(Process::CLOCK_MONOTONIC) - start
+      Builtins.y2milestone("Probe took %1s", @timings["probe"])
 
       if !Arch.s390 && Builtins.size(@controllers) == 0
         Builtins.y2milestone("no controllers")
@@ -293,6 +305,65 @@ module Yast
     # // O: list of [ loaded modules, module argument ]
 
     def Initialize
+      module_loaded = false
+      @loaded_modules = []
+      @failed_modules = []
+
+      # the steps are run by a job graph timing each of them, the raid
+      # personalities are loaded concurrently after the controllers, raid5
+      # and raid6 are aliases of the same module on current kernels so they
+      # are loaded one after the other
+      graph = JobGraph.new
+      graph.add(:controllers) { module_loaded = StartControllers() }
+      personalities = [["raid0"], ["raid1"], ["raid5", "raid6"], ["raid10"], ["dm-multipath"]]
+      personalities.each do |mods|
+        graph.command(
+          mods.first.to_sym,
+          mods.map { |m| "/sbin/modprobe #{m.shellescape}" },
+          :after => [:controllers]
+        )
+      end
+      graph.add(:hotplug, :after => [:controllers]) { StartHotplugStorage() }
+      # the loaded modules create their devices asynchronously, wait once
+      # for udev so rereading the target map sees them
+      graph.command(
+        :settle,
+        ["/usr/bin/udevadm settle --timeout=20"],
+        :after => personalities.map { |mods| mods.first.to_sym } + [:hotplug]
+      )
+      graph.run
+      graph.timings.each { |name, time| @timings[name.to_s] = time }
+      personalities.each do |mods|
+        mods.zip(graph.statuses[mods.first.to_sym]).each do |mod, status|
+          if status == 0
+            @loaded_modules << mod
+          else
+            Builtins.y2warning("Loading module %1 failed: %2", mod, status)
+            @failed_modules << mod
+          end
+        end
+      end
+
+      Builtins.y2milestone(
+        "Initialize all controllers initialized module_loaded:%1 loaded:%2 failed:%3 timings:%4",
+        module_loaded,
+        @loaded_modules,
+        @failed_modules,
+        @timings
+      )
+
+      StorageDevices.InitDone
+      Storage.ReReadTargetMap if module_loaded
+      Builtins.y2milestone("Initialize calling EnablePopup()")
+      StorageClients.EnablePopup
+
+      nil
+    end
+
+    # Starts all probed controllers
+    #
+    # @return [Boolean] true if any module was loaded
+    def StartControllers
       @moduleNames = []
       @moduleArgs = []
       cindex = 0
@@ -399,32 +470,20 @@ module Yast
       #   Initrd.AddModule(Ops.get_string(s, 0, ""), Ops.get_string(s, 1, ""))
       # end
 
-      # load all raid personalities
-      SCR.Execute(path(".target.modprobe"), "raid0", "")
-      SCR.Execute(path(".target.modprobe"), "raid1", "")
-      SCR.Execute(path(".target.modprobe"), "raid5", "")
-      SCR.Execute(path(".target.modprobe"), "raid6", "")
-      SCR.Execute(path(".target.modprobe"), "raid10", "")
-      SCR.Execute(path(".target.modprobe"), "dm-multipath", "")
-
-      StartHotplugStorage()
-
-      Builtins.y2milestone(
-        "Initialize all controllers initialized module_loaded:%1",
-        module_loaded
-      )
-
-      StorageDevices.InitDone
-      Storage.ReReadTargetMap if module_loaded
-      Builtins.y2milestone("Initialize calling EnablePopup()")
-      StorageClients.EnablePopup
+      module_loaded
+    end
 
-      nil
+    # Run time in seconds of the probing and initialisation steps
+    #
+    # @return [Hash{String => Float}]
+    def Timings
+      deep_copy(@timings)
     end
 
     publish :function => :Probe, :type => "integer ()"
     publish :function => :StartHotplugStorage, :type => "void ()"
     publish :function => :Initialize, :type => "void ()"
+    publish :function => :Timings, :type => "map <string, float> ()"
   end
 
   StorageControllers = StorageControllersClass.new
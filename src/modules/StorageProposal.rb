@@ -34,6 +34,7 @@
 #***********************************************************
 require "yast"
 require "storage/target_map_formatter"
+require "storage/operation_stats"
 
 module Yast
   class StorageProposalClass < Module
@@ -78,6 +79,12 @@ module Yast
 
       @swapable = {}
       @ishome = {}
+
+      OperationStats.instance.instrument(
+        self,
+        "StorageProposal",
+        self.class.published_functions.keys
+      )
     end
 
 
@@ -24,6 +24,7 @@
 # Authors:	Thomas Fehr <fehr@suse.de>
 #		Arvin Schnell <aschnell@suse.de>
 require "yast"
+require "shellwords"
 
 module Yast
   class StorageUpdateClass < Module
@@ -43,118 +44,72 @@ module Yast
       @called_update = false
     end
 
-    def UpdateFstabSubfs
+    # Numbers of the lines of a file read by AsciiFile
+    #
+    # Lines removed by earlier stages are skipped.
+    def LineNumbers(file_ref)
+      Ops.get_map(file_ref.value, "l", {}).keys.sort
+    end
+
+
+    def FstabSubfs(fstab_ref)
       Builtins.y2milestone(
         "UpdateFstabSubfs removing fstab entries for cdrom and floppy"
       )
-      tabpath = Storage.PathToDestdir("/etc/fstab")
-      fstab = Partitions.GetFstab(tabpath)
-      line = 0
-      rem_lines = []
-      while Ops.less_or_equal(line, AsciiFile.NumLines(fstab))
-        l = (
-          fstab_ref = arg_ref(fstab);
-          _GetLine_result = AsciiFile.GetLine(fstab_ref, line);
-          fstab = fstab_ref.value;
-          _GetLine_result
-        )
-        if Builtins.search(
-            Ops.get_string(l, ["fields", 1], ""),
-            "/media/floppy"
-          ) == 0
-          rem_lines = Builtins.add(rem_lines, line)
-        elsif Builtins.search(
-            Ops.get_string(l, ["fields", 1], ""),
-            "/media/cdrom"
-          ) == 0 ||
-            Builtins.search(Ops.get_string(l, ["fields", 1], ""), "/media/dvd") == 0 ||
-            Builtins.search(
-              Ops.get_string(l, ["fields", 1], ""),
-              "/media/cdrecorder"
-            ) == 0 ||
-            Builtins.search(
-              Ops.get_string(l, ["fields", 1], ""),
-              "/media/dvdrecorder"
-            ) == 0 ||
-            Builtins.search(Ops.get_string(l, ["fields", 1], ""), "/cdrom") == 0 ||
-            Builtins.search(Ops.get_string(l, ["fields", 1], ""), "/dvd") == 0 ||
-            Builtins.search(Ops.get_string(l, ["fields", 1], ""), "/cdrecorder") == 0 ||
-            Builtins.search(
-              Ops.get_string(l, ["fields", 1], ""),
-              "/dvdrecorder"
-            ) == 0
-          rem_lines = Builtins.add(rem_lines, line)
+      prefixes = [
+        "/media/floppy",
+        "/media/cdrom",
+        "/media/dvd",
+        "/media/cdrecorder",
+        "/media/dvdrecorder",
+        "/cdrom",
+        "/dvd",
+        "/cdrecorder",
+        "/dvdrecorder"
+      ]
+      rem_lines = LineNumbers(fstab_ref).select do |line|
+        l = AsciiFile.GetLine(fstab_ref, line)
+        prefixes.any? do |prefix|
+          Builtins.search(Ops.get_string(l, ["fields", 1], ""), prefix) == 0
         end
-        line = Ops.add(line, 1)
       end
       Builtins.y2milestone("UpdateFstabSubfs %1", rem_lines)
-      if Ops.greater_than(Builtins.size(rem_lines), 0)
-        rem_lines = Builtins.sort(rem_lines)
-        fstab_ref = arg_ref(fstab)
-        AsciiFile.RemoveLines(fstab_ref, rem_lines)
-        fstab = fstab_ref.value
-      end
-      fstab_ref = arg_ref(fstab)
-      AsciiFile.RewriteFile(fstab_ref, tabpath)
-      fstab = fstab_ref.value
-
-      nil
+      AsciiFile.RemoveLines(fstab_ref, rem_lines) if !rem_lines.empty?
+      rem_lines.size
     end
 
 
-    def UpdateFstabSysfs
+    # Must run before any stage removing lines since AsciiFile.AppendLine
+    # numbers the new line by the number of lines
+    def FstabSysfs(fstab_ref)
       Builtins.y2milestone("UpdateFstabSysfs called")
-      tabpath = Storage.PathToDestdir("/etc/fstab")
-      fstab = Partitions.GetFstab(tabpath)
-      line = 0
-      have_sysfs = false
-      while !have_sysfs && Ops.less_or_equal(line, AsciiFile.NumLines(fstab))
-        l = (
-          fstab_ref = arg_ref(fstab);
-          _GetLine_result = AsciiFile.GetLine(fstab_ref, line);
-          fstab = fstab_ref.value;
-          _GetLine_result
-        )
-        have_sysfs = Ops.get_string(l, ["fields", 1], "") == "/sys"
-        line = Ops.add(line, 1)
-      end
-      if !have_sysfs
-        entry = FileSystems.GetFstabDefaultMap("sys")
-        fstlist = [
-          Ops.get_string(entry, "spec", ""),
-          Ops.get_string(entry, "mount", ""),
-          Ops.get_string(entry, "vfstype", ""),
-          Ops.get_string(entry, "mntops", ""),
-          Builtins.sformat("%1", Ops.get_integer(entry, "freq", 0)),
-          Builtins.sformat("%1", Ops.get_integer(entry, "passno", 0))
-        ]
-        Builtins.y2milestone("UpdateFstabSysfs entry %1", entry)
-        Builtins.y2milestone("UpdateFstabSysfs fstlist %1", fstlist)
-        fstab_ref = arg_ref(fstab)
-        AsciiFile.AppendLine(fstab_ref, fstlist)
-        fstab = fstab_ref.value
-        fstab_ref = arg_ref(fstab)
-        AsciiFile.RewriteFile(fstab_ref, tabpath)
-        fstab = fstab_ref.value
+      have_sysfs = LineNumbers(fstab_ref).any? do |line|
+        l = AsciiFile.GetLine(fstab_ref, line)
+        Ops.get_string(l, ["fields", 1], "") == "/sys"
       end
-
-      nil
+      return 0 if have_sysfs
+
+      entry = FileSystems.GetFstabDefaultMap("sys")
+      fstlist = [
+        Ops.get_string(entry, "spec", ""),
+        Ops.get_string(entry, "mount", ""),
+        Ops.get_string(entry, "vfstype", ""),
+        Ops.get_string(entry, "mntops", ""),
+        Builtins.sformat("%1", Ops.get_integer(entry, "freq", 0)),
+        Builtins.sformat("%1", Ops.get_integer(entry, "passno", 0))
+      ]
+      Builtins.y2milestone("UpdateFstabSysfs entry %1", entry)
+      Builtins.y2milestone("UpdateFstabSysfs fstlist %1", fstlist)
+      AsciiFile.AppendLine(fstab_ref, fstlist)
+      1
     end
 
 
-    def UpdateFstabHotplugOption
+    def FstabHotplugOption(fstab_ref)
       Builtins.y2milestone("UpdateFstabHotplugOption")
-      tabpath = Storage.PathToDestdir("/etc/fstab")
-      fstab = Partitions.GetFstab(tabpath)
-      line = 0
-      n = ""
-      while Ops.less_or_equal(line, AsciiFile.NumLines(fstab))
-        l = (
-          fstab_ref = arg_ref(fstab);
-          _GetLine_result = AsciiFile.GetLine(fstab_ref, line);
-          fstab = fstab_ref.value;
-          _GetLine_result
-        )
+      changes = 0
+      LineNumbers(fstab_ref).each do |line|
+        l = AsciiFile.GetLine(fstab_ref, line)
         options = Ops.get_string(l, ["fields", 3], "")
         if Builtins.regexpmatch(options, "^(.*,)?hotplug(,.*)?$")
           options = Builtins.regexpsub(
@@ -162,302 +117,98 @@ module Yast
             "^(.*,)?hotplug(,.*)?$",
             "\\1nofail\\2"
           )
-          fstab_ref = arg_ref(fstab)
           AsciiFile.ChangeLineField(fstab_ref, line, 3, options)
-          fstab = fstab_ref.value
+          changes += 1
         end
-        line = Ops.add(line, 1)
       end
-      fstab_ref = arg_ref(fstab)
-      AsciiFile.RewriteFile(fstab_ref, tabpath)
-      fstab = fstab_ref.value
-
-      nil
+      changes
     end
 
 
-    def UpdateFstabPersistentNames
-      Builtins.y2milestone(
-        "UpdateFstabPersistentDevNames updating to SLES10 names"
-      )
-      tabpath = Storage.PathToDestdir("/etc/fstab")
-      fstab = Partitions.GetFstab(tabpath)
-      line = 0
-      n = ""
-      while Ops.less_or_equal(line, AsciiFile.NumLines(fstab))
-        l = (
-          fstab_ref = arg_ref(fstab);
-          _GetLine_result = AsciiFile.GetLine(fstab_ref, line);
-          fstab = fstab_ref.value;
-          _GetLine_result
-        )
-        n = Storage.SLES9PersistentDevNames(
-          Ops.get_string(l, ["fields", 0], "")
-        )
-        if n != Ops.get_string(l, ["fields", 0], "")
-          fstab_ref = arg_ref(fstab)
-          AsciiFile.ChangeLineField(fstab_ref, line, 0, n)
-          fstab = fstab_ref.value
+    # Replaces field of every line of file by the result of the block if it
+    # differs
+    #
+    # @return [Fixnum] number of changed lines
+    def ChangeField(file_ref, field)
+      changes = 0
+      LineNumbers(file_ref).each do |line|
+        l = AsciiFile.GetLine(file_ref, line)
+        old = Ops.get_string(l, ["fields", field], "")
+        n = yield old
+        if n != old
+          AsciiFile.ChangeLineField(file_ref, line, field, n)
+          changes += 1
         end
-        line = Ops.add(line, 1)
       end
-      fstab_ref = arg_ref(fstab)
-      AsciiFile.RewriteFile(fstab_ref, tabpath)
-      fstab = fstab_ref.value
-
-      nil
+      changes
     end
 
 
-    def UpdateMdadm
-      Builtins.y2milestone("UpdateMdadm")
-      cpath = Storage.PathToDestdir("/etc/mdadm.conf")
-      file = {}
-      file_ref = arg_ref(file)
-      AsciiFile.SetComment(file_ref, "^[ \t]*#")
-      file = file_ref.value
-      file_ref = arg_ref(file)
-      AsciiFile.ReadFile(file_ref, cpath)
-      file = file_ref.value
-      line = 0
-      changed = false
-      while Ops.less_or_equal(line, AsciiFile.NumLines(file))
-        if Builtins.search(
-            Ops.get_string(file, ["l", line, "line"], ""),
-            "DEVICE"
-          ) != nil &&
-            Builtins.search(
-              Ops.get_string(file, ["l", line, "line"], ""),
-              "/dev/"
-            ) != nil
-          changed = true
-          Ops.set(file, ["l", line, "line"], "DEVICE partitions")
-          Builtins.y2milestone(
-            "UpdateMdadm %1",
-            Ops.get_map(file, ["l", line], {})
-          )
-        end
-        line = Ops.add(line, 1)
-      end
-      if changed
-        file_ref = arg_ref(file)
-        AsciiFile.RewriteFile(file_ref, cpath)
-        file = file_ref.value
-      end
-
-      nil
+    def FstabPersistentNames(fstab_ref)
+      Builtins.y2milestone(
+        "UpdateFstabPersistentDevNames updating to SLES10 names"
+      )
+      ChangeField(fstab_ref, 0) { |dev| Storage.SLES9PersistentDevNames(dev) }
     end
 
 
-    def UpdateFstabDiskmap(diskmap)
-      diskmap = deep_copy(diskmap)
+    def FstabDiskmap(fstab_ref, crtab_ref, diskmap)
       Builtins.y2milestone("UpdateFstabDiskmap map %1", diskmap)
-      tabpath = Storage.PathToDestdir("/etc/fstab")
-      fstab = Partitions.GetFstab(tabpath)
-      line = 0
-      n = ""
-      while Ops.less_or_equal(line, AsciiFile.NumLines(fstab))
-        l = (
-          fstab_ref = arg_ref(fstab);
-          _GetLine_result = AsciiFile.GetLine(fstab_ref, line);
-          fstab = fstab_ref.value;
-          _GetLine_result
-        )
-        n = Storage.HdDiskMap(Ops.get_string(l, ["fields", 0], ""), diskmap)
-        if n != Ops.get_string(l, ["fields", 0], "")
-          fstab_ref = arg_ref(fstab)
-          AsciiFile.ChangeLineField(fstab_ref, line, 0, n)
-          fstab = fstab_ref.value
-        end
-        line = Ops.add(line, 1)
-      end
-      fstab_ref = arg_ref(fstab)
-      AsciiFile.RewriteFile(fstab_ref, tabpath)
-      fstab = fstab_ref.value
-      tabpath = Storage.PathToDestdir("/etc/cryptotab")
-      crtab = Partitions.GetCrypto(tabpath)
-      line = 0
-      while Ops.less_or_equal(line, AsciiFile.NumLines(crtab))
-        l = (
-          crtab_ref = arg_ref(crtab);
-          _GetLine_result = AsciiFile.GetLine(crtab_ref, line);
-          crtab = crtab_ref.value;
-          _GetLine_result
-        )
-        n = Storage.HdDiskMap(Ops.get_string(l, ["fields", 1], ""), diskmap)
-        if n != Ops.get_string(l, ["fields", 1], "")
-          crtab_ref = arg_ref(crtab)
-          AsciiFile.ChangeLineField(crtab_ref, line, 1, n)
-          crtab = crtab_ref.value
-        end
-        line = Ops.add(line, 1)
-      end
-      crtab_ref = arg_ref(crtab)
-      AsciiFile.RewriteFile(crtab_ref, tabpath)
-      crtab = crtab_ref.value
-
-      nil
+      ChangeField(fstab_ref, 0) { |dev| Storage.HdDiskMap(dev, diskmap) } +
+        ChangeField(crtab_ref, 1) { |dev| Storage.HdDiskMap(dev, diskmap) }
     end
 
 
-    def UpdateFstabUsbdevfs
+    def FstabUsbdevfs(fstab_ref)
       Builtins.y2milestone("UpdateFstabUsbdevfs updating usbdevfs to usbfs")
-      changed = false
-      tabpath = Storage.PathToDestdir("/etc/fstab")
-      fstab = Partitions.GetFstab(tabpath)
-      line = 0
-      while Ops.less_or_equal(line, AsciiFile.NumLines(fstab))
-        l = (
-          fstab_ref = arg_ref(fstab);
-          _GetLine_result = AsciiFile.GetLine(fstab_ref, line);
-          fstab = fstab_ref.value;
-          _GetLine_result
-        )
+      changes = 0
+      LineNumbers(fstab_ref).each do |line|
+        l = AsciiFile.GetLine(fstab_ref, line)
         if Ops.get_string(l, ["fields", 2], "") == "usbdevfs"
-          fstab_ref = arg_ref(fstab)
           AsciiFile.ChangeLineField(fstab_ref, line, 2, "usbfs")
-          fstab = fstab_ref.value
-          fstab_ref = arg_ref(fstab)
           AsciiFile.ChangeLineField(fstab_ref, line, 0, "usbfs")
-          fstab = fstab_ref.value
-          changed = true
+          changes += 1
         end
-        line = Ops.add(line, 1)
       end
-      if changed
-        Builtins.y2milestone("UpdateFstabUsbdevfs changed")
-        fstab_ref = arg_ref(fstab)
-        AsciiFile.RewriteFile(fstab_ref, tabpath)
-        fstab = fstab_ref.value
-      end
-
-      nil
+      changes
     end
 
 
-    def UpdateFstabIseriesVd
+    def FstabIseriesVd(fstab_ref, crtab_ref)
       Builtins.y2milestone("UpdateFstabIseriesVd updating hdx to iseries/vdx")
-      tabpath = Storage.PathToDestdir("/etc/fstab")
-      fstab = Partitions.GetFstab(tabpath)
-      line = 0
-      n = ""
-      while Ops.less_or_equal(line, AsciiFile.NumLines(fstab))
-        l = (
-          fstab_ref = arg_ref(fstab);
-          _GetLine_result = AsciiFile.GetLine(fstab_ref, line);
-          fstab = fstab_ref.value;
-          _GetLine_result
-        )
-        n = Storage.HdToIseries(Ops.get_string(l, ["fields", 0], ""))
-        if n != Ops.get_string(l, ["fields", 0], "")
-          fstab_ref = arg_ref(fstab)
-          AsciiFile.ChangeLineField(fstab_ref, line, 0, n)
-          fstab = fstab_ref.value
-        end
-        line = Ops.add(line, 1)
-      end
-      fstab_ref = arg_ref(fstab)
-      AsciiFile.RewriteFile(fstab_ref, tabpath)
-      fstab = fstab_ref.value
-      tabpath = Storage.PathToDestdir("/etc/cryptotab")
-      crtab = Partitions.GetCrypto(tabpath)
-      line = 0
-      while Ops.less_or_equal(line, AsciiFile.NumLines(crtab))
-        l = (
-          crtab_ref = arg_ref(crtab);
-          _GetLine_result = AsciiFile.GetLine(crtab_ref, line);
-          crtab = crtab_ref.value;
-          _GetLine_result
-        )
-        n = Storage.HdToIseries(Ops.get_string(l, ["fields", 1], ""))
-        if n != Ops.get_string(l, ["fields", 1], "")
-          crtab_ref = arg_ref(crtab)
-          AsciiFile.ChangeLineField(crtab_ref, line, 1, n)
-          crtab = crtab_ref.value
-        end
-        line = Ops.add(line, 1)
-      end
-      crtab_ref = arg_ref(crtab)
-      AsciiFile.RewriteFile(crtab_ref, tabpath)
-      crtab = crtab_ref.value
-
-      nil
+      ChangeField(fstab_ref, 0) { |dev| Storage.HdToIseries(dev) } +
+        ChangeField(crtab_ref, 1) { |dev| Storage.HdToIseries(dev) }
     end
 
 
-    def UpdateCryptoType
+    def CryptoType(fstab_ref, crtab_ref)
       Builtins.y2milestone("UpdateCryptoType")
-      tabpath = Storage.PathToDestdir("/etc/fstab")
-      fstab = Partitions.GetFstab(tabpath)
-      line = 0
-      pos = 0
       searchstr = "encryption=twofish256"
-      while Ops.less_or_equal(line, AsciiFile.NumLines(fstab))
-        l = (
-          fstab_ref = arg_ref(fstab);
-          _GetLine_result = AsciiFile.GetLine(fstab_ref, line);
-          fstab = fstab_ref.value;
-          _GetLine_result
-        )
-        pos = Builtins.search(Ops.get_string(l, ["fields", 3], ""), searchstr)
+      changes = ChangeField(fstab_ref, 3) do |options|
+        pos = Builtins.search(options, searchstr)
         if pos != nil
-          new = Builtins.substring(Ops.get_string(l, ["fields", 3], ""), 0, pos)
+          new = Builtins.substring(options, 0, pos)
           new = Ops.add(new, "encryption=twofishSL92")
           new = Ops.add(
             new,
-            Builtins.substring(
-              Ops.get_string(l, ["fields", 3], ""),
-              Ops.add(pos, Builtins.size(searchstr))
-            )
+            Builtins.substring(options, Ops.add(pos, Builtins.size(searchstr)))
           )
-          Builtins.y2milestone("new options line in %1 is %2", l, new)
-          fstab_ref = arg_ref(fstab)
-          AsciiFile.ChangeLineField(fstab_ref, line, 3, new)
-          fstab = fstab_ref.value
+          Builtins.y2milestone("new options %1 are %2", options, new)
+          options = new
         end
-        line = Ops.add(line, 1)
+        options
       end
-      fstab_ref = arg_ref(fstab)
-      AsciiFile.RewriteFile(fstab_ref, tabpath)
-      fstab = fstab_ref.value
-      tabpath = Storage.PathToDestdir("/etc/cryptotab")
-      crtab = Partitions.GetCrypto(tabpath)
-      line = 0
-      while Ops.less_or_equal(line, AsciiFile.NumLines(crtab))
-        l = (
-          crtab_ref = arg_ref(crtab);
-          _GetLine_result = AsciiFile.GetLine(crtab_ref, line);
-          crtab = crtab_ref.value;
-          _GetLine_result
-        )
-        if Ops.get_string(l, ["fields", 4], "") == "twofish256"
-          Builtins.y2milestone("set twofishSL92 in line %1", l)
-          crtab_ref = arg_ref(crtab)
-          AsciiFile.ChangeLineField(crtab_ref, line, 4, "twofishSL92")
-          crtab = crtab_ref.value
-        end
-        line = Ops.add(line, 1)
+      changes + ChangeField(crtab_ref, 4) do |type|
+        type == "twofish256" ? "twofishSL92" : type
       end
-      crtab_ref = arg_ref(crtab)
-      AsciiFile.RewriteFile(crtab_ref, tabpath)
-      crtab = crtab_ref.value
-
-      nil
     end
 
-    def UpdateFstabCryptNofail
+
+    def FstabCryptNofail(fstab_ref)
       Builtins.y2milestone("UpdateFstabCryptNofail called")
-      tabpath = Storage.PathToDestdir("/etc/fstab")
-      fstab = Partitions.GetFstab(tabpath)
-      line = 0
-      update = false
-      while Ops.less_or_equal(line, AsciiFile.NumLines(fstab))
-        l = (
-          fstab_ref = arg_ref(fstab);
-          _GetLine_result = AsciiFile.GetLine(fstab_ref, line);
-          fstab = fstab_ref.value;
-          _GetLine_result
-        )
+      changes = 0
+      LineNumbers(fstab_ref).each do |line|
+        l = AsciiFile.GetLine(fstab_ref, line)
         if Builtins.search(
             Ops.get_string(l, ["fields", 0], ""),
             "/dev/mapper/cr_"
@@ -466,68 +217,39 @@ module Yast
           ls = Builtins.filter(ls) { |s| s != "noauto" }
           if Builtins.size(Builtins.filter(ls) { |s| s == "nofail" }) == 0
             ls = Builtins.add(ls, "nofail")
-            fstab_ref = arg_ref(fstab)
             AsciiFile.ChangeLineField(
               fstab_ref,
               line,
               3,
               Builtins.mergestring(ls, ",")
             )
-            fstab = fstab_ref.value
-            update = true
+            changes += 1
           end
         end
-        line = Ops.add(line, 1)
-      end
-      if update
-        fstab_ref = arg_ref(fstab)
-        AsciiFile.RewriteFile(fstab_ref, tabpath)
-        fstab = fstab_ref.value
       end
-
-      nil
+      changes
     end
 
-    def UpdateFstabWindowsMounts
+
+    def FstabWindowsMounts(fstab_ref)
       Builtins.y2milestone("UpdateFstabWindowsMounts called")
-      tabpath = Storage.PathToDestdir("/etc/fstab")
-      fstab = Partitions.GetFstab(tabpath)
-      rem_lines = []
-      line = 0
-      while Ops.less_or_equal(line, AsciiFile.NumLines(fstab))
-        l = (
-          fstab_ref = arg_ref(fstab);
-          _GetLine_result = AsciiFile.GetLine(fstab_ref, line);
-          fstab = fstab_ref.value;
-          _GetLine_result
-        )
-        if Builtins.search(Ops.get_string(l, ["fields", 1], ""), "/windows/") == 0 &&
-            Builtins.size(Ops.get_string(l, ["fields", 1], "")) == 10 ||
-            Builtins.search(Ops.get_string(l, ["fields", 1], ""), "/dos/") == 0 &&
-              Builtins.size(Ops.get_string(l, ["fields", 1], "")) == 6
-          rem_lines = Builtins.add(rem_lines, line)
-        end
-        line = Ops.add(line, 1)
+      rem_lines = LineNumbers(fstab_ref).select do |line|
+        l = AsciiFile.GetLine(fstab_ref, line)
+        Builtins.search(Ops.get_string(l, ["fields", 1], ""), "/windows/") == 0 &&
+          Builtins.size(Ops.get_string(l, ["fields", 1], "")) == 10 ||
+          Builtins.search(Ops.get_string(l, ["fields", 1], ""), "/dos/") == 0 &&
+            Builtins.size(Ops.get_string(l, ["fields", 1], "")) == 6
       end
-      if Ops.greater_than(Builtins.size(rem_lines), 0)
-        rem_lines = Builtins.sort(rem_lines)
+      if !rem_lines.empty?
         Builtins.y2milestone("UpdateFstabWindowsMounts %1", rem_lines)
-        fstab_ref = arg_ref(fstab)
         AsciiFile.RemoveLines(fstab_ref, rem_lines)
-        fstab = fstab_ref.value
-        fstab_ref = arg_ref(fstab)
-        AsciiFile.RewriteFile(fstab_ref, tabpath)
-        fstab = fstab_ref.value
       end
-
-      nil
+      rem_lines.size
     end
 
-    def UpdateFstabRemoveSystemdMps
+
+    def FstabRemoveSystemdMps(fstab_ref)
       Builtins.y2milestone("UpdateFstabRemoveSystemdMps called")
-      tabpath = Storage.PathToDestdir("/etc/fstab")
-      fstab = Partitions.GetFstab(tabpath)
-      rem_lines = []
       rem_dirs = [
         "/proc",
         "/sys",
@@ -535,95 +257,158 @@ module Yast
         "/dev/pts",
         "/proc/bus/usb"
       ]
-      line = 0
-      while Ops.less_or_equal(line, AsciiFile.NumLines(fstab))
-        l = (
-          fstab_ref = arg_ref(fstab);
-          _GetLine_result = AsciiFile.GetLine(fstab_ref, line);
-          fstab = fstab_ref.value;
-          _GetLine_result
-        )
-        if Builtins.contains(rem_dirs, Ops.get_string(l, ["fields", 1], ""))
-          rem_lines = Builtins.add(rem_lines, line)
-        end
-        line = Ops.add(line, 1)
+      rem_lines = LineNumbers(fstab_ref).select do |line|
+        l = AsciiFile.GetLine(fstab_ref, line)
+        Builtins.contains(rem_dirs, Ops.get_string(l, ["fields", 1], ""))
       end
-      if Ops.greater_than(Builtins.size(rem_lines), 0)
-        rem_lines = Builtins.sort(rem_lines)
+      if !rem_lines.empty?
         Builtins.y2milestone("UpdateFstabRemoveSystemdMps %1", rem_lines)
-        fstab_ref = arg_ref(fstab)
         AsciiFile.RemoveLines(fstab_ref, rem_lines)
-        fstab = fstab_ref.value
-        fstab_ref = arg_ref(fstab)
-        AsciiFile.RewriteFile(fstab_ref, tabpath)
-        fstab = fstab_ref.value
       end
-
-      nil
+      rem_lines.size
     end
 
 
-    def UpdateFstabDmraidToMdadm()
+    def FstabDmraidToMdadm(fstab_ref, crtab_ref, mapping)
       Builtins.y2milestone("UpdateFstabDmraidToMdadm")
+      ChangeField(fstab_ref, 0) do |dev|
+        Storage.TranslateDeviceDmraidToMdadm(dev, mapping)
+      end +
+        ChangeField(crtab_ref, 1) do |dev|
+          Storage.TranslateDeviceDmraidToMdadm(dev, mapping)
+        end
+    end
 
-      mapping = Storage.GetDmraidToMdadm()
-      if mapping.empty?
-        return
-      end
-
-      fstab_path = Storage.PathToDestdir("/etc/fstab")
-      fstab = Partitions.GetFstab(fstab_path)
-
-      for line in 1..AsciiFile.NumLines(fstab)
-        l = (
-          fstab_ref = arg_ref(fstab);
-          _GetLine_result = AsciiFile.GetLine(fstab_ref, line);
-          fstab = fstab_ref.value;
-          _GetLine_result
-        )
 
-        device = Ops.get_string(l, ["fields", 0], "")
+    # Replaces the file at fpath by the content of the AsciiFile map in one
+    # step
+    #
+    # A symlink is followed, the temporary file is written next to the file
+    # it points to and gets its mode, owner and SELinux context before it is
+    # renamed over it by a single shell call.
+    #
+    # @return [Boolean] true on success
+    def ReplaceFile(file_ref, fpath)
+      target = ResolveSymlink(fpath)
+      tmp = "#{target}.YaST2new"
+      AsciiFile.RewriteFile(file_ref, tmp)
+
+      t = target.shellescape
+      n = tmp.shellescape
+      cmd = "if [ -e #{t} ]; then " \
+        "chmod --reference=#{t} #{n} && chown --reference=#{t} #{n} && " \
+        "{ chcon --reference=#{t} #{n} 2>/dev/null || true; }; fi && " \
+        "/bin/mv -f #{n} #{t} || { /bin/rm -f #{n}; exit 1; }"
+      ret = SCR.Execute(path(".target.bash"), cmd) == 0
+      Builtins.y2error("ReplaceFile failed: %1", cmd) if !ret
+
+      ret
+    end
 
-        device = Storage.TranslateDeviceDmraidToMdadm(device, mapping)
 
-        if device != Ops.get_string(l, ["fields", 0], "")
-          fstab_ref = arg_ref(fstab)
-          AsciiFile.ChangeLineField(fstab_ref, line, 0, device)
-          fstab = fstab_ref.value
+    # Follows symlinks, absolute link targets are relative to the installed
+    # system
+    #
+    # @return [String] path of the file fpath points to
+    def ResolveSymlink(fpath)
+      10.times do
+        link = SCR.Read(path(".target.symlink"), fpath)
+        break if link.nil? || link.empty?
+        fpath = if link.start_with?("/")
+          Storage.PathToDestdir(link)
+        else
+          File.join(File.dirname(fpath), link)
         end
       end
+      fpath
+    end
 
-      fstab_ref = arg_ref(fstab)
-      AsciiFile.RewriteFile(fstab_ref, fstab_path)
-      fstab = fstab_ref.value
 
+    # Runs the update stages on fstab and cryptotab
+    #
+    # Both files are read once, all stages are applied in order and each
+    # file is written once if any stage changed it.
+    #
+    # @param stages [Array] pairs of stage name and lambda getting the
+    #   references to fstab and cryptotab and returning the number of changes
+    # @return [Boolean] false if writing a file failed, the remaining files
+    #   are not written then
+    def RunStages(stages)
+      return true if stages.empty?
+
+      fstab_path = Storage.PathToDestdir("/etc/fstab")
       crtab_path = Storage.PathToDestdir("/etc/cryptotab")
-      crtab = Partitions.GetCrypto(crtab_path)
+      fstab_ref = arg_ref(Partitions.GetFstab(fstab_path))
+      crtab_ref = arg_ref(Partitions.GetCrypto(crtab_path))
+      files = [[fstab_ref, fstab_path], [crtab_ref, crtab_path]]
+      lines = files.map { |file_ref, _fpath| LineNumbers(file_ref) }
+
+      stages.each do |name, stage|
+        start = Process.clock_gettime(Process::CLOCK_MONOTONIC)
+        changes = stage.call(fstab_ref, crtab_ref)
+        time = Process.clock_gettime(Process::CLOCK_MONOTONIC) - start
+        Builtins.y2milestone("RunStages %1 changes:%2 time:%3s", name, changes, time)
+      end
+
+      files.zip(lines).each do |(file_ref, fpath), old_lines|
+        changed = LineNumbers(file_ref) != old_lines ||
+          Ops.get_map(file_ref.value, "l", {}).values.any? { |l| l["changed"] }
+        next if !changed
+        return false if !ReplaceFile(file_ref, fpath)
+      end
+
+      true
+    end
 
-      for line in 1..AsciiFile.NumLines(crtab)
-        l = (
-          crtab_ref = arg_ref(crtab);
-          _GetLine_result = AsciiFile.GetLine(crtab_ref, line);
-          crtab = crtab_ref.value;
-          _GetLine_result
-        )
 
-        device = Ops.get_string(l, ["fields", 1], "")
+    def UpdateFstabHotplugOption
+      RunStages(
+        [["HotplugOption", lambda { |fstab, crtab| FstabHotplugOption(fstab) }]]
+      )
+
+      nil
+    end
 
-        device = Storage.TranslateDeviceDmraidToMdadm(device, mapping)
 
-        if device != Ops.get_string(l, ["fields", 1], "")
-          crtab_ref = arg_ref(crtab)
-          AsciiFile.ChangeLineField(crtab_ref, line, 1, device)
-          crtab = crtab_ref.value
+    def UpdateMdadm
+      Builtins.y2milestone("UpdateMdadm")
+      cpath = Storage.PathToDestdir("/etc/mdadm.conf")
+      file = {}
+      file_ref = arg_ref(file)
+      AsciiFile.SetComment(file_ref, "^[ \t]*#")
+      file = file_ref.value
+      file_ref = arg_ref(file)
+      AsciiFile.ReadFile(file_ref, cpath)
+      file = file_ref.value
+      line = 0
+      changed = false
+      while Ops.less_or_equal(line, AsciiFile.NumLines(file))
+        if Builtins.search(
+            Ops.get_string(file, ["l", line, "line"], ""),
+            "DEVICE"
+          ) != nil &&
+            Builtins.search(
+              Ops.get_string(file, ["l", line, "line"], ""),
+              "/dev/"
+            ) != nil
+          changed = true
+          Ops.set(file, ["l", line, "line"], "DEVICE partitions")
+          Builtins.y2milestone(
+            "UpdateMdadm %1",
+            Ops.get_map(file, ["l", line], {})
+          )
+        end
+        line = Ops.add(line, 1)
+      end
+      if changed
+        file_ref = arg_ref(file)
+        if !ReplaceFile(file_ref, cpath)
+          Builtins.y2error("UpdateMdadm writing %1 failed", cpath)
         end
+        file = file_ref.value
       end
 
-      crtab_ref = arg_ref(crtab)
-      AsciiFile.RewriteFile(crtab_ref, crtab_path)
-      crtab = crtab_ref.value
-
-      return
+      nil
     end
 
 
@@ -677,29 +462,50 @@ module Yast
           Builtins.y2error("Missing key major or minor")
         end
 
+        # the fstab and cryptotab changes are collected as stages and
+        # applied by RunStages with a single read and write per file
+        stages = []
+
         if Ops.less_or_equal(Ops.get_integer(oldv, "major", 0), 9)
-          UpdateFstabSysfs()
+          stages << ["Sysfs", lambda { |fstab, crtab| FstabSysfs(fstab) }]
         end
         if Ops.less_than(Ops.get_integer(oldv, "major", 0), 9)
-          UpdateFstabUsbdevfs()
+          stages << ["Usbdevfs", lambda { |fstab, crtab| FstabUsbdevfs(fstab) }]
+        end
+        if Ops.get_integer(oldv, "major", 0) == 9
+          stages << [
+            "PersistentNames",
+            lambda { |fstab, crtab| FstabPersistentNames(fstab) }
+          ]
         end
-        UpdateFstabPersistentNames() if Ops.get_integer(oldv, "major", 0) == 9
 
         if Ops.less_or_equal(Ops.get_integer(oldv, "major", 0), 10)
-          UpdateFstabHotplugOption()
+          stages << [
+            "HotplugOption",
+            lambda { |fstab, crtab| FstabHotplugOption(fstab) }
+          ]
         end
 
-        UpdateFstabDmraidToMdadm()
+        mapping = Storage.GetDmraidToMdadm()
+        if !mapping.empty?
+          stages << [
+            "DmraidToMdadm",
+            lambda { |fstab, crtab| FstabDmraidToMdadm(fstab, crtab, mapping) }
+          ]
+        end
 
         dm = Storage.BuildDiskmap(oldv)
         if Ops.greater_than(Builtins.size(dm), 0)
-          UpdateFstabDiskmap(dm)
+          stages << [
+            "Diskmap",
+            lambda { |fstab, crtab| FstabDiskmap(fstab, crtab, dm) }
+          ]
           UpdateMdadm()
         end
         if Ops.less_than(Ops.get_integer(oldv, "major", 0), 9) ||
             Ops.get_integer(oldv, "major", 0) == 9 &&
               Ops.less_or_equal(Ops.get_integer(oldv, "minor", 0), 2)
-          UpdateCryptoType()
+          stages << ["CryptoType", lambda { |fstab, crtab| CryptoType(fstab, crtab) }]
         end
         if Ops.less_than(Ops.get_integer(oldv, "major", 0), 10) ||
             Ops.get_integer(oldv, "major", 0) == 10 &&
@@ -721,12 +527,17 @@ module Yast
         if Ops.less_than(Ops.get_integer(oldv, "major", 0), 10) ||
             Ops.get_integer(oldv, "major", 0) == 10 &&
               Ops.get_integer(oldv, "minor", 0) == 0
-          UpdateFstabSubfs()
+          stages << ["Subfs", lambda { |fstab, crtab| FstabSubfs(fstab) }]
         end
         if Ops.less_than(Ops.get_integer(oldv, "major", 0), 9) ||
             Ops.get_integer(oldv, "major", 0) == 9 &&
               Ops.get_integer(oldv, "minor", 0) == 0
-          UpdateFstabIseriesVd() if Arch.board_iseries
+          if Arch.board_iseries
+            stages << [
+              "IseriesVd",
+              lambda { |fstab, crtab| FstabIseriesVd(fstab, crtab) }
+            ]
+          end
         end
         if Ops.less_than(Ops.get_integer(oldv, "major", 0), 10) ||
             Ops.get_integer(oldv, "major", 0) == 10 &&
@@ -742,15 +553,20 @@ module Yast
         if Ops.less_than(Ops.get_integer(oldv, "major", 0), 11) ||
             Ops.get_integer(oldv, "major", 0) == 11 &&
               Ops.less_or_equal(Ops.get_integer(oldv, "minor", 0), 2)
-          UpdateFstabCryptNofail()
+          stages << ["CryptNofail", lambda { |fstab, crtab| FstabCryptNofail(fstab) }]
         end
         # 	    if( oldv["major"]:0<=11 || (oldv["major"]:0==12 && oldv["minor"]:0<=1))
         # 		UpdateFstabWindowsMounts();
         if Ops.less_than(Ops.get_integer(oldv, "major", 0), 13)
-          UpdateFstabRemoveSystemdMps()
+          stages << [
+            "RemoveSystemdMps",
+            lambda { |fstab, crtab| FstabRemoveSystemdMps(fstab) }
+          ]
         end
-        # set flag -> it indicates that Update was already called
-        @called_update = true
+
+        # set flag -> it indicates that Update was already called, not
+        # set if writing the files failed so a later call tries again
+        @called_update = RunStages(stages)
       else
         Builtins.y2milestone("Skip calling Update() -> It was already called")
       end
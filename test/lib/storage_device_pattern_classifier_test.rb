@@ -0,0 +1,43 @@
+#!/usr/bin/env rspec
+
+require_relative "../spec_helper"
+require "storage/device_pattern_classifier"
+
+describe Yast::DevicePatternClassifier do
+  subject(:classifier) do
+    Yast::DevicePatternClassifier.new(
+      [["sdb", "B"], ["sd.*", "A"], ["by-id/ata", "C"], ["(", "X"]]
+    )
+  end
+
+  describe "#match" do
+    it "returns the class of the first matching pattern" do
+      expect(classifier.match(["/dev/sdb1"])).to eq "B"
+      expect(classifier.match(["/dev/sda1"])).to eq "A"
+    end
+
+    it "prefers the pattern order over the order of the names" do
+      expect(classifier.match(["/dev/disk/by-id/ata-disk", "/dev/sda"])).to eq "A"
+    end
+
+    it "matches any of the names" do
+      expect(classifier.match(["/dev/hda", "/dev/disk/by-id/ata-disk"])).to eq "C"
+    end
+
+    it "returns nil if no pattern matches" do
+      expect(classifier.match(["/dev/hda"])).to be_nil
+    end
+
+    it "keeps anchors of the patterns" do
+      anchored = Yast::DevicePatternClassifier.new([["^/dev/sdc$", "E"], [".*", "Z"]])
+      expect(anchored.match(["/dev/sdc"])).to eq "E"
+      expect(anchored.match(["/dev/sdc1"])).to eq "Z"
+    end
+
+    it "supports patterns with back references" do
+      backref = Yast::DevicePatternClassifier.new([["(sd)\\1", "D"], ["hd", "H"]])
+      expect(backref.match(["/dev/sdsd"])).to eq "D"
+      expect(backref.match(["/dev/hda"])).to eq "H"
+    end
+  end
+end
@@ -0,0 +1,65 @@
+#!/usr/bin/env rspec
+
+require_relative "../spec_helper"
+require "storage/job_graph"
+
+describe Yast::JobGraph do
+  subject(:graph) { Yast::JobGraph.new }
+
+  # runs the script like bash would if every command exits with status
+  def bash_output(script, status = 0)
+    out = script.scan(/echo "(\S+ \d+ \d+) \$\?"/).map { |m| "#{m[0]} #{status}\n" }
+    { "exit" => 0, "stdout" => out.join, "stderr" => "" }
+  end
+
+  before do
+    allow(Yast::SCR).to receive(:Execute) { |_path, script| bash_output(script) }
+  end
+
+  describe "#run" do
+    it "runs jobs after their dependencies" do
+      order = []
+      graph.add(:second, after: [:first]) { order << :second }
+      graph.add(:first) { order << :first }
+      graph.run
+      expect(order).to eq [:first, :second]
+    end
+
+    it "runs the commands of independent jobs concurrently with a single SCR call" do
+      expect(Yast::SCR).to receive(:Execute).once do |_path, script|
+        expect(script).to match(/\A\( modprobe raid0 .*\) & \( modprobe raid5 .*modprobe raid6 .*\) & wait\z/)
+        bash_output(script)
+      end
+      graph.command(:raid0, ["modprobe raid0"])
+      graph.command(:raid5, ["modprobe raid5", "modprobe raid6"])
+      graph.run
+    end
+
+    it "records the exit status of every command" do
+      allow(Yast::SCR).to receive(:Execute) { |_path, script| bash_output(script, 1) }
+      graph.command(:raid5, ["modprobe raid5", "modprobe raid6"])
+      graph.run
+      expect(graph.statuses).to eq(raid5: [1, 1])
+    end
+
+    it "reports commands without status as failed" do
+      allow(Yast::SCR).to receive(:Execute).and_return(nil)
+      graph.command(:raid0, ["modprobe raid0"])
+      graph.run
+      expect(graph.statuses).to eq(raid0: [-1])
+    end
+
+    it "records the time of every job" do
+      graph.command(:raid, ["modprobe raid0"])
+      graph.add(:hotplug, after: [:raid]) {}
+      graph.run
+      expect(graph.timings.keys).to contain_exactly(:raid, :hotplug)
+    end
+
+    it "raises an error for unsatisfiable dependencies" do
+      graph.add(:first, after: [:second]) {}
+      graph.add(:second, after: [:first]) {}
+      expect { graph.run }.to raise_error(RuntimeError, /first/)
+    end
+  end
+end
@@ -0,0 +1,32 @@
+#!/usr/bin/env rspec
+
+require_relative "../spec_helper"
+require "storage/mount_point_trie"
+
+describe Yast::MountPointTrie do
+  subject(:trie) { Yast::MountPointTrie.new(["/", "/home", "/var/log", "swap"]) }
+
+  describe "#shadowing" do
+    it "returns the mount point equal to the path" do
+      expect(trie.shadowing("/home")).to eq "/home"
+    end
+
+    it "returns the mount point containing the path" do
+      expect(trie.shadowing("/var/log/journal")).to eq "/var/log"
+    end
+
+    it "returns nil for paths only sharing a prefix with a mount point" do
+      expect(trie.shadowing("/home2")).to be_nil
+      expect(trie.shadowing("/var")).to be_nil
+    end
+
+    it "does not consider / as parent of other paths" do
+      expect(trie.shadowing("/")).to eq "/"
+      expect(trie.shadowing("/usr/local")).to be_nil
+    end
+
+    it "ignores mount points which are no paths" do
+      expect(trie.shadowing("/swap")).to be_nil
+    end
+  end
+end
@@ -0,0 +1,35 @@
+#!/usr/bin/env rspec
+
+require_relative "../spec_helper"
+require "storage/operation_stats"
+
+describe Yast::OperationStats do
+  subject(:stats) { Yast::OperationStats.instance }
+
+  describe "#measure" do
+    it "returns the result of the block" do
+      expect(stats.measure("test.result") { 42 }).to eq 42
+    end
+
+    it "accounts calls and allocated objects" do
+      2.times { stats.measure("test.alloc") { Array.new(10) { "x" * 10 } } }
+      op = stats.stats["operations"]["test.alloc"]
+      expect(op["calls"]).to eq 2
+      expect(op["allocated"]).to be >= 20
+    end
+
+    it "accounts operations raising exceptions" do
+      expect { stats.measure("test.raise") { raise "failed" } }.to raise_error(RuntimeError)
+      expect(stats.stats["operations"]["test.raise"]["calls"]).to eq 1
+    end
+  end
+
+  describe ".deep_size" do
+    it "counts shared objects only once" do
+      part = { "device" => "/dev/sda1" * 100 }
+      single = described_class.deep_size([part])
+      expect(described_class.deep_size([part, part])).to eq single
+      expect(described_class.deep_size([part, part.dup])).to be > single
+    end
+  end
+end
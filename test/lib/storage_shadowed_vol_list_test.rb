@@ -0,0 +1,100 @@
+#!/usr/bin/env rspec
+
+require_relative "../spec_helper"
+require "storage/shadowed_vol_list"
+
+describe Yast::ShadowedVolList do
+  let(:partition) do
+    {
+      "device" => "/dev/sda2",
+      "mount"  => "/",
+      "subvol" => [
+        { "name" => "@/home" },
+        { "name" => "@/home/user/data" },
+        { "name" => "@/home2" },
+        { "name" => "@/var" },
+        { "name" => "@/var/lib/mysql" },
+        { "name" => "@/var/lib/mysql/data" },
+        { "name" => "@/boot/grub2/i386-pc" },
+        { "name" => "@/srv" }
+      ]
+    }
+  end
+
+  def names(list)
+    list.map { |subvol| subvol["name"] }
+  end
+
+  before do
+    allow(Yast::FileSystems).to receive(:default_subvol).and_return("@")
+  end
+
+  context "with several mount points" do
+    subject(:list) do
+      Yast::ShadowedVolList.new(
+        partition:    partition,
+        mount_points: ["/home", "/var/lib", "/boot/grub2"]
+      )
+    end
+
+    it "returns the subvolumes at or below any of the mount points" do
+      expect(names(list)).to eq [
+        "@/home",
+        "@/home/user/data",
+        "@/var/lib/mysql",
+        "@/var/lib/mysql/data",
+        "@/boot/grub2/i386-pc"
+      ]
+    end
+
+    it "does not return subvolumes only sharing a name prefix" do
+      expect(names(list)).to_not include("@/home2")
+    end
+
+    it "does not return subvolumes above a mount point" do
+      expect(names(list)).to_not include("@/var")
+    end
+  end
+
+  context "with nested mount points" do
+    subject(:list) do
+      Yast::ShadowedVolList.new(
+        partition:    partition,
+        mount_points: ["/var/lib/mysql", "/var"]
+      )
+    end
+
+    it "returns every shadowed subvolume once" do
+      expect(names(list)).to eq [
+        "@/var",
+        "@/var/lib/mysql",
+        "@/var/lib/mysql/data"
+      ]
+    end
+  end
+
+  context "without default subvolume" do
+    subject(:list) do
+      Yast::ShadowedVolList.new(partition: partition, mount_points: ["/srv", "/home"])
+    end
+
+    before do
+      allow(Yast::FileSystems).to receive(:default_subvol).and_return("")
+    end
+
+    it "uses the subvolume names as paths" do
+      partition["subvol"] = [{ "name" => "srv" }, { "name" => "home/user" }, { "name" => "opt" }]
+      expect(names(list)).to eq ["srv", "home/user"]
+    end
+  end
+
+  context "with a single mount point" do
+    subject(:list) do
+      Yast::ShadowedVolList.new(partition: partition, mount_point: "/srv")
+    end
+
+    it "returns the subvolumes shadowed by it" do
+      expect(names(list)).to eq ["@/srv"]
+    end
+  end
+end
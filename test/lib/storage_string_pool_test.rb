@@ -0,0 +1,50 @@
+#!/usr/bin/env rspec
+
+require_relative "../spec_helper"
+require "storage/string_pool"
+
+describe Yast::StringPool do
+  subject(:pool) { Yast::StringPool.new }
+
+  describe "#intern" do
+    it "returns the same frozen instance for equal strings" do
+      first = pool.intern("/dev/sda1".dup)
+      second = pool.intern("/dev/sda1".dup)
+      expect(first).to be_frozen
+      expect(second).to equal(first)
+      expect(pool.size).to eq 1
+    end
+
+    it "does not freeze the given string" do
+      name = "/dev/sda1".dup
+      pool.intern(name)
+      expect(name).not_to be_frozen
+    end
+
+    it "returns nil for nil" do
+      expect(pool.intern(nil)).to be_nil
+    end
+  end
+
+  describe "#find" do
+    it "returns the interned string" do
+      interned = pool.intern("/dev/sda1".dup)
+      expect(pool.find("/dev/sda1".dup)).to equal(interned)
+    end
+
+    it "returns the string itself if it is not interned" do
+      name = "/dev/sdb"
+      expect(pool.find(name)).to equal(name)
+      expect(pool.size).to eq 0
+    end
+  end
+
+  describe "#clear" do
+    it "forgets the interned strings" do
+      first = pool.intern("/dev/sda1".dup)
+      pool.clear
+      expect(pool.size).to eq 0
+      expect(pool.intern("/dev/sda1".dup)).not_to equal(first)
+    end
+  end
+end
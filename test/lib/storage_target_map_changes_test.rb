@@ -0,0 +1,118 @@
+#!/usr/bin/env rspec
+
+require_relative "../spec_helper"
+require "storage/target_map_changes"
+
+describe Yast::TargetMapChanges do
+  subject(:changes) { Yast::TargetMapChanges.new }
+
+  let(:target_map) do
+    {
+      "/dev/sda" => {
+        "device"     => "/dev/sda",
+        "free_cyl"   => 100,
+        "partitions" => [{ "device" => "/dev/sda1", "size_k" => 1024 }]
+      }
+    }
+  end
+
+  def change_target_map
+    target_map["/dev/sda"]["free_cyl"] = 50
+    target_map["/dev/sda"]["partitions"][0]["mount"] = "/"
+    target_map["/dev/sda"]["partitions"] << { "device" => "/dev/sda2" }
+  end
+
+  describe "#record" do
+    it "does nothing until tracking starts" do
+      expect(changes.record(1, target_map)).to be_nil
+      expect(changes.since(0)).to be_nil
+    end
+
+    it "returns the added, removed and changed devices" do
+      changes.track(1, target_map)
+      change_target_map
+      expect(changes.record(2, target_map)).to eq(
+        "generation" => 2,
+        "added"      => ["/dev/sda2"],
+        "removed"    => [],
+        "changed"    => { "/dev/sda" => ["free_cyl"], "/dev/sda1" => ["mount"] }
+      )
+    end
+
+    it "reports deleted partitions as removed" do
+      changes.track(1, target_map)
+      target_map["/dev/sda"]["partitions"][0]["delete"] = true
+      expect(changes.record(2, target_map)["removed"]).to eq ["/dev/sda1"]
+    end
+
+    it "keys partitions sharing a device name by mount point" do
+      target_map["/dev/tmpfs"] = {
+        "device"     => "/dev/tmpfs",
+        "partitions" => [
+          { "device" => "tmpfs", "mount" => "/run" },
+          { "device" => "tmpfs", "mount" => "/tmp" }
+        ]
+      }
+      changes.track(1, target_map)
+      target_map["/dev/tmpfs"]["partitions"][1]["fstopt"] = "size=1G"
+      expect(changes.record(2, target_map)["changed"]).to eq("tmpfs@/tmp" => ["fstopt"])
+    end
+
+    it "only compares the given containers" do
+      target_map["/dev/sdb"] = { "device" => "/dev/sdb", "free_cyl" => 10 }
+      changes.track(1, target_map)
+      change_target_map
+      target_map["/dev/sdb"]["free_cyl"] = 5
+      event = changes.record(2, target_map, ["/dev/sda"])
+      expect(event["changed"].keys).to contain_exactly("/dev/sda", "/dev/sda1")
+      expect(changes.record(3, target_map)["changed"]).to eq("/dev/sdb" => ["free_cyl"])
+    end
+
+    it "reports removed containers with their partitions" do
+      changes.track(1, target_map)
+      target_map.delete("/dev/sda")
+      expect(changes.record(2, target_map, ["/dev/sda"])["removed"])
+        .to contain_exactly("/dev/sda", "/dev/sda1")
+    end
+
+    it "passes frozen events to the subscribers" do
+      events = []
+      changes.subscribe { |event| events << event }
+      changes.track(1, target_map)
+      change_target_map
+      changes.record(2, target_map)
+      expect(events[0]).to be_frozen
+      expect(events[0]["added"]).to be_frozen
+      expect(events[0]["changed"]["/dev/sda"]).to be_frozen
+      expect { events[0]["added"] << "/dev/sdb" }.to raise_error(RuntimeError)
+    end
+
+    it "notifies the subscribers" do
+      events = []
+      id = changes.subscribe { |event| events << event }
+      changes.track(1, target_map)
+      changes.record(2, target_map)
+      expect(changes.unsubscribe(id)).to eq true
+      changes.record(3, target_map)
+      expect(events.map { |e| e["generation"] }).to eq [2]
+    end
+  end
+
+  describe "#since" do
+    before do
+      changes.track(1, target_map)
+      change_target_map
+      changes.record(2, target_map)
+      changes.record(3, target_map)
+    end
+
+    it "returns the events after the generation" do
+      expect(changes.since(1).map { |e| e["generation"] }).to eq [2, 3]
+      expect(changes.since(3)).to eq []
+    end
+
+    it "returns nil for generations before tracking started" do
+      expect(changes.since(0)).to be_nil
+    end
+  end
+end
@@ -0,0 +1,67 @@
+#!/usr/bin/env rspec
+
+require_relative "../spec_helper"
+require "storage/used_storage_features"
+
+describe Yast::StorageHelpers::UsedStorageFeatures do
+  subject(:collector) { Yast::StorageHelpers::UsedStorageFeatures.new(storage) }
+
+  let(:storage) do
+    double("StorageInterface", getContainers: 0, getVolumes: 0, getEfiBoot: false)
+  end
+
+  def volume(device, name, mount = "", fs: ::Storage::BTRFS, fstab_options: "")
+    double(
+      "VolumeInfo",
+      device:        device,
+      name:          name,
+      mount:         mount,
+      usedBy:        [],
+      fs:            fs,
+      encryption:    ::Storage::ENC_NONE,
+      uuid:          fs == ::Storage::BTRFS ? "1234" : "",
+      fstab_options: fstab_options,
+      userdata:      {}
+    )
+  end
+
+  # two partitions and the btrfs volume on both of them, libstorage reports
+  # the first partition as device of the volume
+  let(:volumes) do
+    [
+      volume("/dev/sda2", "/dev/sda2"),
+      volume("/dev/sdb2", "/dev/sdb2"),
+      volume("/dev/sda2", "/dev/btrfs/1234")
+    ]
+  end
+
+  before do
+    allow(::Storage::DequeContainerInfo).to receive(:new).and_return([])
+    allow(::Storage::DequeVolumeInfo).to receive(:new).and_return(volumes)
+  end
+
+  describe "#invalidate" do
+    it "checks the devices of a changed multi-device btrfs volume again" do
+      expect(collector.collect_features).to eq [:FT_BTRFS]
+      volumes[2] = volume("/dev/sda2", "/dev/btrfs/1234", "/")
+      collector.invalidate(["UUID=1234"])
+      expect(collector.collect_features).to contain_exactly(:FT_BTRFS, :FT_BTRFS_ROOT)
+    end
+
+    it "checks a volume sharing its device name again" do
+      volumes << volume("tmpfs", "tmpfs", "/tmp", fs: ::Storage::TMPFS)
+      collector.collect_features
+      volumes[3] = volume("tmpfs", "tmpfs", "/tmp", fs: ::Storage::TMPFS,
+        fstab_options: "usrquota")
+      collector.invalidate(["tmpfs@/tmp"])
+      expect(collector.collect_features).to contain_exactly(:FT_BTRFS, :FT_QUOTA)
+    end
+
+    it "keeps the cached features of other devices" do
+      collector.collect_features
+      volumes[2] = volume("/dev/sda2", "/dev/btrfs/1234", "/")
+      collector.invalidate(["/dev/sdc1"])
+      expect(collector.collect_features).to eq [:FT_BTRFS]
+    end
+  end
+end
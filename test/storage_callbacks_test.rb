@@ -0,0 +1,65 @@
+#!/usr/bin/env rspec
+
+require_relative "spec_helper"
+require "tmpdir"
+
+Yast.import "StorageClients"
+Yast.import "StorageCallbacks"
+
+describe "Yast::StorageCallbacks" do
+  around do |example|
+    Dir.mktmpdir { |dir| @dir = dir; example.run }
+  end
+
+  let(:file) { File.join(@dir, "callbacks") }
+
+  before do
+    allow(Yast::Report).to receive(:AnyQuestion).and_return(false)
+    allow(Yast::Report).to receive(:ErrorAnyQuestion).and_return(true)
+    Yast::StorageClients.InstallCallbacks(nil)
+  end
+
+  after do
+    Yast::StorageCallbacks.StopRecording
+  end
+
+  # callbacks are only called by libstorage, so their lines are appended
+  # the way they are recorded
+  def record_session(lines)
+    expect(Yast::StorageCallbacks.StartRecording(file)).to eq true
+    Yast::StorageCallbacks.StopRecording
+    File.open(file, "a") { |f| lines.each { |l| f.puts(l.join("\t")) } }
+  end
+
+  describe "#Replay" do
+    before do
+      record_session([[0, 10, "YesNoPopup", "Really?", "0"]])
+      record_session([[5, 10, "CommitErrorPopup", "-3000", "mounting", "busy", "1"]])
+    end
+
+    it "replays all sessions of a recording including commit errors" do
+      expect(Yast::Report).to receive(:ErrorAnyQuestion)
+        .with(anything, /mounting/, anything, anything, anything).and_return(true)
+      expect(File.readlines(file).map(&:chomp)).to include("# session")
+      expect(Yast::StorageCallbacks.Replay(file, 0)).to eq true
+    end
+
+    it "reports answers differing from the recording" do
+      allow(Yast::Report).to receive(:ErrorAnyQuestion).and_return(false)
+      expect(Yast::StorageCallbacks.Replay(file, 0)).to eq false
+    end
+
+    it "does not replay the file being recorded to" do
+      Yast::StorageCallbacks.StartRecording(file)
+      expect(Yast::StorageCallbacks.Replay(file, 0)).to eq false
+    end
+
+    it "does not record the replayed callbacks" do
+      other = File.join(@dir, "other")
+      Yast::StorageCallbacks.StartRecording(other)
+      Yast::StorageCallbacks.Replay(file, 0)
+      Yast::StorageCallbacks.StopRecording
+      expect(File.readlines(other).size).to eq 1
+    end
+  end
+end
@@ -0,0 +1,67 @@
+#!/usr/bin/env rspec
+
+require_relative "spec_helper"
+
+Yast.import "StorageControllers"
+
+describe "Yast::StorageControllers" do
+  subject { Yast::StorageControllers }
+
+  describe "#Initialize" do
+    let(:steps) { [] }
+    let(:status) { 0 }
+
+    before do
+      allow(subject).to receive(:StartControllers) do
+        steps << :controllers
+        false
+      end
+      allow(subject).to receive(:StartHotplugStorage) { steps << :hotplug }
+      allow(Yast::SCR).to receive(:Execute) do |_path, script|
+        steps << script.scan(%r{(/[^;]*?) >/dev/null}).flatten
+        out = script.scan(/echo "(\S+ \d+ \d+) \$\?"/).map { |m| "#{m[0]} #{status}\n" }
+        { "exit" => 0, "stdout" => out.join, "stderr" => "" }
+      end
+      allow(Yast::StorageDevices).to receive(:InitDone)
+      allow(Yast::StorageClients).to receive(:EnablePopup)
+    end
+
+    it "loads the raid personalities together after the controllers and settles udev once" do
+      subject.Initialize
+      expect(steps).to eq [
+        :controllers,
+        [
+          "/sbin/modprobe raid0",
+          "/sbin/modprobe raid1",
+          "/sbin/modprobe raid5",
+          "/sbin/modprobe raid6",
+          "/sbin/modprobe raid10",
+          "/sbin/modprobe dm-multipath"
+        ],
+        :hotplug,
+        ["/usr/bin/udevadm settle --timeout=20"]
+      ]
+    end
+
+    it "records the time of every step" do
+      subject.Initialize
+      expect(subject.Timings.keys).to include("controllers", "raid0", "hotplug", "settle")
+    end
+
+    it "rereads the target map only if a controller module was loaded" do
+      allow(subject).to receive(:StartControllers).and_return(true)
+      expect(Yast::Storage).to receive(:ReReadTargetMap)
+      subject.Initialize
+    end
+
+    context "when modules fail to load" do
+      let(:status) { 1 }
+
+      it "logs every failed module" do
+        expect(Yast::Builtins).to receive(:y2warning)
+          .with(/failed/, anything, 1).exactly(6).times
+        subject.Initialize
+      end
+    end
+  end
+end
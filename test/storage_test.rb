@@ -27,4 +27,98 @@ describe "Yast::Storage" do
       expect(subject.default_subvolume_name).to eq("SOME-VALUE")
     end
   end
+
+  describe "#HandleBtrfsSimpleVolumes" do
+    let(:target_map) do
+      {
+        "/dev/sda"   => {
+          "device"     => "/dev/sda",
+          "partitions" => [
+            { "device" => "/dev/sda1", "used_fs" => :swap, "label" => "old" },
+            { "device" => "/dev/sda2", "used_fs" => :btrfs, "label" => "old" }
+          ]
+        },
+        "/dev/btrfs" => {
+          "device"     => "/dev/btrfs",
+          "partitions" => [
+            { "device" => "/dev/sda2", "devices" => ["/dev/sda2"], "used_fs" => :btrfs,
+              "mount" => "/", "subvol" => [{ "name" => "@/home" }] },
+            { "device" => "UUID=1234", "devices" => ["/dev/sdb", "/dev/sdc"],
+              "used_fs" => :btrfs }
+          ]
+        }
+      }
+    end
+
+    it "moves simple volumes into their partitions" do
+      tg = subject.HandleBtrfsSimpleVolumes(target_map)
+      sda2 = tg["/dev/sda"]["partitions"][1]
+      expect(sda2["mount"]).to eq("/")
+      expect(sda2["subvol"]).to eq([{ "name" => "@/home" }])
+      expect(sda2).to_not have_key("label")
+      expect(tg["/dev/btrfs"]["partitions"].map { |p| p["device"] }).to eq(["UUID=1234"])
+    end
+
+    it "does not modify the passed target map" do
+      subject.HandleBtrfsSimpleVolumes(target_map)
+      expect(target_map["/dev/sda"]["partitions"][1]).to_not have_key("mount")
+      expect(target_map["/dev/btrfs"]["partitions"].size).to eq(2)
+    end
+  end
+
+  describe "#refreshBtrfsVolumes" do
+    let(:old_multi) do
+      { "device" => "UUID=1234", "uuid" => "1234", "devices" => ["/dev/sdb", "/dev/sdc"],
+        "used_fs" => :btrfs }
+    end
+
+    let(:target_map) do
+      {
+        "/dev/sda"   => {
+          "device"     => "/dev/sda",
+          "partitions" => [{ "device" => "/dev/sda2", "used_fs" => :btrfs }]
+        },
+        "/dev/sdb"   => { "device" => "/dev/sdb", "partitions" => [] },
+        "/dev/btrfs" => { "device" => "/dev/btrfs", "partitions" => [old_multi] }
+      }
+    end
+
+    def btrfs_info(uuid, devices)
+      double("BtrfsInfo", v: double(uuid: uuid), devices: devices, devices_add: [],
+        devices_rem: [])
+    end
+
+    let(:infos) do
+      [btrfs_info("1234", ["/dev/sdb", "/dev/sdc"]), btrfs_info("5678", ["/dev/sda2"])]
+    end
+
+    before do
+      allow(::Storage::DequeBtrfsInfo).to receive(:new).and_return(infos)
+      allow(subject.instance_variable_get(:@sint)).to receive(:getBtrfsInfo).and_return(0)
+      allow(subject).to receive(:btrfsVolumeMap) do |info|
+        { "device" => info.devices.size > 1 ? "UUID=#{info.v.uuid}" : info.devices.first,
+          "uuid" => info.v.uuid, "devices" => info.devices, "used_fs" => :btrfs,
+          "mount" => "/" }
+      end
+    end
+
+    it "reads only the volumes using the changed devices again" do
+      tg = subject.refreshBtrfsVolumes(target_map, ["/dev/sda2"])
+      expect(subject).to have_received(:btrfsVolumeMap).once
+      expect(tg["/dev/btrfs"]["partitions"]).to eq([old_multi])
+      expect(tg["/dev/btrfs"]["partitions"][0]).to equal(old_multi)
+      expect(tg["/dev/sda"]["partitions"][0]["mount"]).to eq("/")
+    end
+
+    it "refreshes volumes on several devices using a changed device" do
+      tg = subject.refreshBtrfsVolumes(target_map, ["/dev/sdc"])
+      expect(tg["/dev/btrfs"]["partitions"][0]["mount"]).to eq("/")
+      expect(tg["/dev/sda"]["partitions"][0]).to_not have_key("mount")
+    end
+
+    it "shares the unchanged containers with the passed target map" do
+      tg = subject.refreshBtrfsVolumes(target_map, ["/dev/sda2"])
+      expect(tg["/dev/sdb"]).to equal(target_map["/dev/sdb"])
+    end
+  end
 end
@@ -0,0 +1,270 @@
+#!/usr/bin/env ruby
+#
+# encoding: utf-8
+
+# Copyright (c) 2016 SUSE LLC
+#
+# All Rights Reserved.
+#
+# This program is free software; you can redistribute it and/or modify it
+# under the terms of version 2 of the GNU General Public License as published
+# by the Free Software Foundation.
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+# more details.
+#
+# You should have received a copy of the GNU General Public License along
+# with this program; if not, contact SUSE LLC.
+#
+# To contact SUSE LLC about this file by physical or electronic mail, you may
+# find current contact information at www.suse.com.
+
+# Runs the installation proposal for every combination of hardware fixture
+# and partitioning variant without UI and prints one JSON line per run.
+#
+# ./batch_proposal.rb [-j jobs] [-v variants.yml] [fixture-dir...]
+#
+# A fixture is a directory with libstorage .info files like the ones in
+# data/, all of them are used if none is given. The variants file maps a
+# name to partitioning features of the control file, see
+# batch_proposal.yml. Every run uses a separate ruby process and working
+# directory, the setup is the same as in tests/helper.rb.
+
+require "etc"
+require "fileutils"
+require "json"
+require "optparse"
+require "rbconfig"
+require "rexml/document"
+require "tmpdir"
+require "yaml"
+
+module BatchProposal
+  DATA_PATH = File.expand_path("../data", __FILE__)
+  SRC_PATH = File.expand_path("../../src", __FILE__)
+  SCRIPT = File.expand_path(__FILE__)
+  # written by the worker into its working directory
+  RESULT_FILE = "result.json"
+
+  # Runs the proposal for one fixture and variant, to be called in a fresh
+  # process since the YaST modules keep their state
+  class Worker
+    def initialize(fixture, features)
+      @fixture = fixture
+      @features = features
+    end
+
+    # Runs the proposal and writes the result to RESULT_FILE
+    def run_and_save
+      ret = begin
+        JSON.generate(run)
+      rescue Exception => e
+        JSON.generate("ok" => false, "error" => "#{e.class}: #{e.message}")
+      end
+      File.write(RESULT_FILE, ret)
+    end
+
+    # @return [Hash] result of the run
+    def run
+      FileUtils.mkdir_p("tmp")
+      FileUtils.cp(Dir.glob(File.join(@fixture, "*.info")), "tmp")
+
+      ENV["Y2DIR"] = SRC_PATH
+      require "yast"
+
+      timings = {}
+      timed(timings, "setup") { setup }
+
+      target_map = timed(timings, "probe") do
+        Yast::Storage.InitLibstorage(false)
+        Yast::StorageProposal.GetControlCfg
+        Yast::Storage.GetTargetMap
+      end
+
+      prop = timed(timings, "proposal") do
+        Yast::StorageProposal.get_inst_prop(target_map)
+      end
+
+      infos = []
+      if prop.fetch("ok", false)
+        timed(timings, "commit_infos") do
+          Yast::Storage.SetTargetMap(prop.fetch("target", {}))
+          infos = Yast::Storage.GetCommitInfos.map { |info| info[:text] }
+        end
+      end
+
+      Yast::Storage.FinishLibstorage
+
+      {
+        "ok"      => prop.fetch("ok", false),
+        "lvm"     => Yast::StorageProposal.GetProposalLvm,
+        "actions" => infos,
+        "target"  => prop["target"],
+        "timings" => timings
+      }
+    end
+
+  protected
+
+    # Same environment as tests/helper.rb
+    def setup
+      Yast.import "Testsuite"
+
+      read = {
+        "probe"     => {
+          "architecture" => architecture,
+          "bios"         => [{ "lba_support" => true }],
+          "cdrom"        => [],
+          "system"       => [{ "system" => system }]
+        },
+        "proc"      => {
+          "swaps"   => [],
+          "meminfo" => { "memtotal" => 256 * 1024 }
+        },
+        "sysconfig" => {
+          "storage"    => { "DEFAULT_FS" => "btrfs" },
+          "bootloader" => { "LOADER_TYPE" => "grub" },
+          "language"   => { "RC_LANG" => "en_US.UTF-8", "RC_LC_MESSAGES" => "" }
+        },
+        "target"    => {
+          "size"        => 0,
+          "string"      => nil,
+          "bash_output" => {},
+          "yast2"       => {},
+          "dir"         => []
+        }
+      }
+      Yast::Testsuite.Init([read, {}, read], nil)
+
+      Yast.import "Stage"
+      Yast.import "ProductFeatures"
+      Yast.import "Storage"
+      Yast.import "StorageProposal"
+
+      Yast::Stage.Set("initial")
+
+      @features.each do |feature, value|
+        case value
+        when true, false
+          Yast::ProductFeatures.SetBooleanFeature("partitioning", feature, value)
+        when Integer
+          Yast::ProductFeatures.SetIntegerFeature("partitioning", feature, value)
+        else
+          Yast::ProductFeatures.SetStringFeature("partitioning", feature, value.to_s)
+        end
+      end
+    end
+
+    # Architecture and system as in tests/helper.rb
+    def architecture
+      read_arch unless defined?(@arch)
+      @arch
+    end
+
+    def system
+      read_arch unless defined?(@system)
+      @system
+    end
+
+    def read_arch
+      @arch = "i386"
+      @system = ""
+      return unless File.exist?("tmp/arch.info")
+      doc = REXML::Document.new(File.new("tmp/arch.info"))
+      @arch = doc.elements["arch"].elements["arch"].text
+      if @arch == "s390x"
+        @arch = "s390_64"
+      elsif @arch == "ppc64le"
+        @arch = "ppc64"
+        @system = REXML::XPath.first(doc, "//arch/ppc_powernv") ? "PowerNV" : "CHRP"
+      end
+    end
+
+    def timed(timings, name)
+      start = Time.now
+      ret = yield
+      timings[name] = Time.now - start
+      ret
+    end
+  end
+
+  # Distributes the runs over worker processes and streams their results
+  class Runner
+    def initialize(fixtures, variants, jobs, output = $stdout)
+      @runs = fixtures.product(variants.to_a)
+      @jobs = jobs
+      @output = output
+      @mutex = Mutex.new
+    end
+
+    def run
+      queue = Queue.new
+      @runs.each { |run| queue << run }
+      threads = Array.new([@jobs, @runs.size].min) do
+        Thread.new do
+          loop do
+            run = begin
+              queue.pop(true)
+            rescue ThreadError
+              break
+            end
+            line = execute(*run)
+            @mutex.synchronize do
+              @output.puts(line)
+              @output.flush
+            end
+          end
+        end
+      end
+      threads.each(&:join)
+    end
+
+  protected
+
+    def execute(fixture, (variant, features))
+      result = {
+        "fixture"  => File.basename(fixture),
+        "variant"  => variant,
+        "features" => features
+      }
+      start = Time.now
+      Dir.mktmpdir("batch-proposal-") do |dir|
+        pid = Process.spawn(
+          RbConfig.ruby, SCRIPT, "--worker", File.expand_path(fixture),
+          JSON.generate(features), chdir: dir, out: File::NULL
+        )
+        Process.wait(pid)
+        file = File.join(dir, RESULT_FILE)
+        if File.exist?(file)
+          result.merge!(JSON.parse(File.read(file)))
+        else
+          result.merge!("ok" => false, "error" => "worker failed: #{$?}")
+        end
+      end
+      result["wall_time"] = Time.now - start
+      JSON.generate(result)
+    end
+  end
+end
+
+if $PROGRAM_NAME == __FILE__ && ARGV[0] == "--worker"
+  BatchProposal::Worker.new(ARGV[1], JSON.parse(ARGV[2])).run_and_save
+elsif $PROGRAM_NAME == __FILE__
+  jobs = Etc.nprocessors
+  variants = { "default" => {} }
+
+  OptionParser.new do |opts|
+    opts.banner = "Usage: #{$PROGRAM_NAME} [options] [fixture-dir...]"
+    opts.on("-j", "--jobs N", Integer, "number of worker processes") { |n| jobs = n }
+    opts.on("-v", "--variants FILE", "partitioning variants (YAML)") do |file|
+      variants = YAML.load_file(file)
+    end
+  end.parse!
+
+  fixtures = ARGV.empty? ? Dir.glob(File.join(BatchProposal::DATA_PATH, "*/")).sort : ARGV
+  fixtures = fixtures.select { |f| !Dir.glob(File.join(f, "*.info")).empty? }
+
+  BatchProposal::Runner.new(fixtures, variants, jobs).run
+end